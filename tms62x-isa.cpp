@@ -21,6 +21,23 @@
 
 #include  "tmsc62x-isa.H"
 #include  "ac_isa_init.cpp"
+#include  "tms62x_ctx.H"
+#include  "tms62x_kernels.H"
+#include  "tms62x_shared.H"
+#include  "tms62x_cache.H"
+#include  "tms62x_map.H"
+#include  "tms62x_decode.H"
+#include  "tms62x_api.h"
+#include  <unistd.h>
+#include  <sys/types.h>
+#include  <sys/wait.h>
+#include  <sys/mman.h>
+#include  <pthread.h>
+#include  <map>
+#include  <vector>
+#include  <cmath>
+#include  <algorithm>
+#include  <cstring>
  
 //Defining Control Registers names
 #define AMR  0
@@ -34,19 +51,24 @@
 #define NRP  7
 #define PCE1 16
 
-//Maximum and minimum constants for 40-bit long data type
-#define MAX_LONG 0x7FFFFFFFFF   
-#define MIN_LONG 0x8000000000   
+//Interrupt enable bits of CSR, and interrupt bits of IFR and IER
+#define CSR_GIE      0x1
+#define CSR_PGIE     0x2
+#define INT_NMI      0x2     //NMIF in IFR, NMIE in IER
+#define INT_MASKABLE 0xFFF0  //INT4 to INT15
 
-//Setting the saturation bit in the CSR register.
-//When an instruction does saturation, it has to set the bit 9 of the CSR register
-#define SATURATE RB_C.write( CSR, ( RB_C.read(CSR) | 0x200 ))
+//Saturating instructions set the sticky flag of the context instead of the
+//bit 9 (SAT) of the CSR register. It is folded into CSR by ctx_fold_sat()
+//whenever CSR is read.
 
-//Debugging function
+//Debugging function. Tracing is only done in detailed mode, and the arguments
+//are not evaluated when it is off.
 #define DEBUG
 #ifdef DEBUG
 #include <stdarg.h>
-inline int dprintf(const char *format, ...)
+bool tracing = true;
+#define dprintf(...) do { if( tracing ) trace_printf(__VA_ARGS__); } while(0)
+inline int trace_printf(const char *format, ...)
 {
   int ret;
 
@@ -62,248 +84,2143 @@ inline void dprintf(const char *format, ...) {}
 #endif
 
 //User defined Variables
-long long cycle_count=0;
+tms62x_ctx main_ctx;
+__thread tms62x_ctx *ctx = &main_ctx;
+
+bool detailed = true;   //Statistics are only collected in detailed mode
+bool trace_enabled = true;  //Tracing in detailed mode, see TMS62X_TRACE
+
+/* Sampled simulation. One functional pass runs the whole application and, at the
+   start of every sampled interval, forks a worker process that simulates that
+   interval in detailed mode. The fork is the checkpoint: the worker inherits the
+   complete simulator state and shares the parent pages copy-on-write.
+   Configured through the environment:
+     TMS62X_SAMPLE_INTERVAL  instructions per interval (unset or 0 disables sampling)
+     TMS62X_SAMPLE_PERIOD    measure one interval out of every PERIOD (default 1)
+     TMS62X_SAMPLE_JOBS      maximum number of concurrent workers (default: online CPUs)
+*/
+struct sample_slot {
+	pid_t pid;
+	long long interval;  //Index of the interval measured by the worker
+	sim_stats st;
+};
+
+long long sample_interval = 0;
+long long sample_period = 1;
+int sample_jobs = 1;
+sample_slot *sample_slots = 0;  //Shared with the workers, one slot per job
+long long sample_end = -1;      //Worker only: instruction count that ends its interval
+int sample_slot_id = -1;        //Worker only: slot where its statistics are stored
+sim_stats sample_total;         //Merged statistics of every finished worker
+int sample_count = 0;
+
+/* Simulation points. When TMS62X_SIMPOINTS names a file written by the phase
+   detection below, only the listed intervals are measured and the results are
+   extrapolated with the interval weights. */
+std::map<long long, double> simpoints;  //Interval index -> weight
+double simpoint_cpi = 0;                //Weighted CPI of the measured points
+double simpoint_weight = 0;             //Sum of the weights already measured
+
+/* Basic-block vector phase detection. The functional run splits the execution
+   into fixed intervals and records, for each one, how many instructions were
+   executed in every basic block. At exit the vectors are clustered and one
+   representative interval per cluster is written, with its weight, to the
+   simulation points file. Configured through the environment:
+     TMS62X_BBV_INTERVAL  instructions per interval (unset or 0 disables it)
+     TMS62X_BBV_K         maximum number of clusters (default 10)
+     TMS62X_BBV_OUTPUT    simulation points file (default tms62x.simpoints)
+*/
+typedef std::map<unsigned, long long> bbv_t;  //Block start pc -> instructions
+
+long long bbv_interval = 0;
+std::vector<bbv_t> bbv_list;  //One vector per finished interval
+bbv_t bbv_cur;
+unsigned bbv_block = 0;       //Start pc of the current basic block
+unsigned bbv_next_pc = 0;     //Fall-through pc of the last instruction
+long long bbv_block_len = 0;  //Instructions executed so far in the current block
+
+/* Simulation modes. The fast mode only executes the instructions: it does not
+   trace nor collect statistics. The detailed mode does both. Registers and
+   memory are shared by both modes, so the mode may be switched at any
+   instruction. Configured through the environment:
+     TMS62X_MODE    initial mode, "fast" or "detailed" (default detailed)
+     TMS62X_SWITCH  comma separated list of triggers; each one toggles the mode
+                    once when reached: pc:<address>, cycle:<n> or insn:<n>
+     TMS62X_TRACE   set to 0 to disable tracing in detailed mode
+*/
+enum { TRIG_PC, TRIG_CYCLE, TRIG_INSN };
+
+struct mode_trigger {
+	int kind;
+	unsigned long long value;
+};
+
+std::vector<mode_trigger> triggers;  //Triggers that have not fired yet
+
+/*--------------------------------------------------------------------------------*/
+//User defined functions
+
+/*This function writes a destination register, checking for
+  the correct register bank.*/
+void writeReg( int s, int dst, int value ){
+
+	ctx->R[(s<<4)|dst] = value;
+	dprintf("Result = %#x (%s)\n", value, s ? "RB_B" : "RB_A");
+}
+
+/* Writes a 40-bit long value to a pair of registers. The upper 24 bits of
+   the odd register are cleared. */
+void writeLong(int s, int dst, long long value ){
+	
+	pair_write(ctx, (s<<4)|dst, value);
+	dprintf("Result = %#llx (%s(%d:%d))\n", pair_read_u(ctx, (s<<4)|dst), s ? "RB_B" : "RB_A", dst+1, dst);
+}
+
+
+/*This function reads a source register. The side bit selects the
+  register bank in the unified register file.*/
+int readReg( int s, int src ){
+
+	return ctx->R[(s<<4)|src];
+}
+
+/* Reads a 40-bit long value, sign extended from bit 39 */
+long long readLong( int s, int src) {
+
+	return pair_read(ctx, (s<<4)|src);
+}
+
+/* Reads a 40-bit long value as unsigned */
+unsigned long long readULong( int s, int src) {
+
+	return pair_read_u(ctx, (s<<4)|src);
+}
+
+/* Loads the operands that may be cross loaded from the register bank that
+   is opposite to the destination reg. The s field indicates the destination
+   register bank and x selects the cross path. Operand fields may also hold
+   control register numbers (mvc), so only the register bits are used. */
+inline void load_operands( int s, int x, int src1, int src2 ){
+
+	int side = (s ^ x) << 4;
+
+	ctx->xsrc1 = ctx->R[side | (src1 & 0xF)];
+	ctx->xsrc2 = ctx->R[side | (src2 & 0xF)];
+}
+
+/* Initializes a context: clear registers and statistics, an empty memory image,
+   the memory map of the environment and empty caches. Returns 0 if they could
+   not be allocated. */
+int ctx_init(tms62x_ctx *c){
+
+	memset(c, 0, sizeof(*c));
+	c->stop_cycle = -1;
+	c->stop_pc = -1;
+	c->mem_size = TMS62X_MEM_SIZE;
+	c->mem = (unsigned char *)calloc(c->mem_size, 1);
+	c->map = map_default();
+
+	return c->mem != 0 && cache_create(c);
+}
+
+/* Releases the memory, the memory map, the caches and the loaded program of a
+   context */
+void ctx_free(tms62x_ctx *c){
+
+	free(c->mem);
+	c->mem = 0;
+	ext_free(c);
+	map_release(c->map);
+	c->map = 0;
+	cache_free(c->cache);
+	c->cache = 0;
+	prog_release(c->prog);
+	c->prog = 0;
+}
+
+/* Copies the registers and the memory contents from the ArchC resources into a context */
+void ctx_load_regs(tms62x_ctx *c){
+
+	int i;
+
+	for( i = 0; i < 16; i++ ){
+		c->R[i] = ac_resources::RB_A.read(i);
+		c->R[16+i] = ac_resources::RB_B.read(i);
+	}
+	for( i = 0; i < 20; i++ )
+		c->RB_C[i] = ac_resources::RB_C.read(i);
+	amr_decode(c);
+	int_update(c);
+
+	for( unsigned a = 0; a < c->mem_size; a++ )
+		c->mem[a] = ac_resources::MEM.read_byte(a);
+}
+
+/* Copies the registers and the memory contents of a context back to the ArchC resources */
+void ctx_store_regs(tms62x_ctx *c){
+
+	int i;
+
+	ctx_fold_sat(c);
+	for( i = 0; i < 16; i++ ){
+		ac_resources::RB_A.write(i, c->R[i]);
+		ac_resources::RB_B.write(i, c->R[16+i]);
+	}
+	for( i = 0; i < 20; i++ )
+		ac_resources::RB_C.write(i, c->RB_C[i]);
+
+	for( unsigned a = 0; a < c->mem_size; a++ )
+		ac_resources::MEM.write_byte(a, c->mem[a]);
+}
+
+/* Leaves the final state of the stand-alone simulator in the ArchC resources */
+void ctx_exit(){
+
+	ctx_store_regs(&main_ctx);
+}
+
+/* Cache hierarchy. An optional model of the L1P, L1D and L2 caches of the
+   C621x/C671x parts. Instruction fetches go through L1P and data accesses
+   through L1D, and both levels miss to L2. A miss charges the penalty of the
+   level to the cycle count; an L2 miss adds the L2 penalty, the external
+   memory latency. Stores do not allocate in L1D and drain through the write
+   buffer without the miss penalties; those that miss L2 too pay the wait
+   states of the memory map, like stores with no cache. The shared region is
+   not cached. Configured
+   through the environment:
+     TMS62X_CACHE  c621x selects the C621x hierarchy: 4KB direct mapped L1P
+                   with 64-byte lines, 4KB 2-way L1D with 32-byte lines and
+                   64KB 4-way L2 with 128-byte lines
+     TMS62X_L1P, TMS62X_L1D, TMS62X_L2
+                   <size>:<line>:<ways>[:<policy>[:<penalty>]] sets or
+                   overrides one level: sizes in bytes, policy lru, fifo or
+                   random (default lru), penalty in cycles (default 5 for
+                   L1P, 4 for L1D and 20 for L2). A size of 0 removes it.
+   With no level configured there is no cache and no stall.
+*/
+cache_level cache_config[3];
+
+/* Reads the geometry of one level from spec */
+void cache_parse(cache_level &l, const char *name, const char *spec){
+
+	unsigned int size, line, ways;
+	char policy[16] = "lru";
+	int n = sscanf(spec, "%u:%u:%u:%15[a-z]:%d", &size, &line, &ways, policy, &l.penalty);
+
+	if( n >= 1 && size == 0 ){
+		l.ways = 0;
+		return;
+	}
+
+	if( n < 3 || line < 4 || (line & (line - 1)) || ways == 0 || ways > 32 ||
+			size % (line * ways) || ((size / (line * ways)) & (size / (line * ways) - 1)) ){
+		cerr << "Invalid " << name << " cache geometry: " << spec << endl;
+		exit(1);
+	}
+
+	if( !strcmp(policy, "lru") )
+		l.policy = CACHE_LRU;
+	else if( !strcmp(policy, "fifo") )
+		l.policy = CACHE_FIFO;
+	else if( !strcmp(policy, "random") )
+		l.policy = CACHE_RANDOM;
+	else{
+		cerr << "Invalid " << name << " replacement policy: " << policy << endl;
+		exit(1);
+	}
+
+	l.sets = size / (line * ways);
+	l.ways = ways;
+	l.line_shift = __builtin_ctz(line);
+}
+
+/* Reads the cache configuration. Returns true if some level is present. */
+bool cache_config_read(){
+
+	static const char *var[3] = { "TMS62X_L1P", "TMS62X_L1D", "TMS62X_L2" };
+	static const char *c621x[3] = { "4096:64:1", "4096:32:2", "65536:128:4" };
+	char *env = getenv("TMS62X_CACHE");
+	bool present = false;
+	int i;
+
+	if( env && strcmp(env, "c621x") ){
+		cerr << "Invalid TMS62X_CACHE: " << env << endl;
+		exit(1);
+	}
+
+	cache_config[CACHE_L1P].penalty = 5;
+	cache_config[CACHE_L1D].penalty = 4;
+	cache_config[CACHE_L2].penalty = 20;
+
+	for( i = 0; i < 3; i++ ){
+		if( env )
+			cache_parse(cache_config[i], var[i], c621x[i]);
+		if( getenv(var[i]) )
+			cache_parse(cache_config[i], var[i], getenv(var[i]));
+		present |= cache_config[i].ways != 0;
+	}
+
+	return present;
+}
+
+int cache_create(tms62x_ctx *c){
+
+	static bool present = cache_config_read();
+
+	c->cache = 0;
+	if( !present )
+		return 1;
+
+	if( !(c->cache = (tms62x_cache *)calloc(1, sizeof(tms62x_cache))) )
+		return 0;
+
+	for( int i = 0; i < 3; i++ ){
+		cache_level &l = c->cache->level[i];
+
+		l = cache_config[i];
+		if( l.ways && !(l.tags = (unsigned int *)calloc(l.sets * l.ways, sizeof(unsigned int))) ){
+			cache_free(c->cache);
+			c->cache = 0;
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+void cache_free(tms62x_cache *cache){
+
+	if( !cache )
+		return;
+
+	for( int i = 0; i < 3; i++ )
+		free(cache->level[i].tags);
+	free(cache);
+}
+
+void cache_invalidate(tms62x_cache *cache){
+
+	for( int i = 0; i < 3; i++ ){
+		cache_level &l = cache->level[i];
+
+		if( l.ways )
+			memset(l.tags, 0, l.sets * l.ways * sizeof(unsigned int));
+		l.seed = 0;
+	}
+}
+
+void cache_copy(tms62x_cache *dst, const tms62x_cache *src){
+
+	for( int i = 0; i < 3; i++ ){
+		const cache_level &l = src->level[i];
+
+		if( l.ways )
+			memcpy(dst->level[i].tags, l.tags, l.sets * l.ways * sizeof(unsigned int));
+		dst->level[i].seed = l.seed;
+	}
+}
+
+/* Looks up the line of addr in one level and, on a miss, allocates it if
+   allocate is set. Returns 1 on a hit. */
+inline int cache_lookup(cache_level &l, unsigned int addr, int allocate){
+
+	unsigned int line = (addr >> l.line_shift) + 1;
+	unsigned int *set = l.tags + ((line - 1) & (l.sets - 1)) * l.ways;
+	unsigned int w, hit = l.ways;
+
+	//Every way is compared, with no early exit, so the loop runs as vector
+	//compares over the packed tags
+	for( w = 0; w < l.ways; w++ )
+		hit = set[w] == line ? w : hit;
+
+	if( hit < l.ways ){
+		if( l.policy == CACHE_LRU ){
+			memmove(set + 1, set, hit * sizeof(unsigned int));
+			set[0] = line;
+		}
+		return 1;
+	}
+
+	if( allocate ){
+		if( l.policy == CACHE_RANDOM ){
+			l.seed = l.seed * 1103515245u + 12345u;
+			set[(l.seed >> 16) % l.ways] = line;
+		}
+		else{
+			memmove(set + 1, set, (l.ways - 1) * sizeof(unsigned int));
+			set[0] = line;
+		}
+	}
+
+	return 0;
+}
+
+/* Charges memory stall cycles to the cycle count */
+inline void mem_stall(int cycles){
+
+	ctx->cycle_count += cycles;
+	if( detailed ){
+		ctx->stats.cycles += cycles;
+		ctx->stats.stalls += cycles;
+	}
+}
+
+/* Accesses addr through the first level (CACHE_L1P or CACHE_L1D) and L2, and
+   charges the stall cycles of the misses. Returns 1 if the access missed
+   every level and reached the memory. */
+int cache_access(int first, unsigned int addr, int write){
+
+	int path[2] = { first, CACHE_L2 };
+	int stall = 0;
+
+	for( int n = 0; n < 2; n++ ){
+		int i = path[n];
+		cache_level &l = ctx->cache->level[i];
+
+		if( !l.ways )
+			continue;
+
+		if( cache_lookup(l, addr, i == CACHE_L2 || !write) ){
+			if( detailed )
+				ctx->stats.hits[i]++;
+			mem_stall(stall);
+			return 0;
+		}
+
+		if( detailed )
+			ctx->stats.misses[i]++;
+		if( !write )
+			stall += l.penalty;
+	}
+
+	mem_stall(stall);
+	return 1;
+}
+
+/* Data memory accesses. Loads and stores use the memory image of the context, in
+   big-endian byte order like the model memory, or the shared region when the
+   core is attached to one. */
+void mem_fault(unsigned addr){
+
+	cerr << "Memory access out of bounds: " << hex << addr << " at pc: " << ctx->pc << dec << endl;
+	exit(1);
+}
+
+/* Memory map. Regions of the address space with their own access cost:
+   internal program and data RAM, the EMIF CE0-CE3 spaces and reserved holes.
+   The contents of the regions are kept in the memory image and, for the
+   addresses beyond it, in pages allocated on first use, so the CE spaces can
+   sit at their real addresses. Configured through the environment, or for
+   each library instance with tms62x_load_map():
+     TMS62X_MEMMAP  file with one region per line (# starts a comment):
+                      <name> <base> <size> <type> [<param>=<value> ...]
+                    type is ram (internal RAM, SRAM or asynchronous memory),
+                    sdram or reserved. Parameters:
+                      wait=<n>     wait states of every access (default 0)
+                      banks=<n>    interleaved banks of the region, up to 32
+                                   (default 1)
+                      width=<n>    bank width in bytes (default 2)
+                      row=<n>      sdram: row size in bytes (default 2048)
+                      rowmiss=<n>  sdram: extra cycles of an access that opens
+                                   another row (default 6)
+                    Base and size are multiples of the page size.
+   Addresses left out of the map have no wait states, and no storage beyond
+   the memory image. The region of an address is found with one lookup in a
+   table with an entry per page.
+
+   Two loads or stores of one execute packet that touch the same bank of an
+   interleaved region conflict, and the packet stalls one cycle. The stalls
+   are reported at exit by execute packet address.
+*/
+
+//The region of the addresses left out of the map, or of every address when there is none
+static const mem_region map_unmapped = { "unmapped", 0, 0, MAP_RAM, 0, 1, 1, 11, 0 };
+
+//Bank conflict stalls by execute packet address, for the stand-alone simulator
+std::map<unsigned int, long long> bank_conflicts;
+
+void map_error(const char *name, int line, const char *msg){
+
+	cerr << name << ":" << line << ": " << msg << endl;
+}
+
+/* Reads the memory map file */
+tms62x_map *map_load(const char *name){
+
+	FILE *f = fopen(name, "r");
+	char buf[256];
+	int line = 0;
+	tms62x_map *map;
+
+	if( !f ){
+		perror(name);
+		return 0;
+	}
+
+	if( !(map = (tms62x_map *)calloc(1, sizeof(tms62x_map))) ||
+			!(map->page = (unsigned char *)calloc(1u << (32 - MAP_PAGE_SHIFT), 1)) ){
+		cerr << "Could not allocate the memory map." << endl;
+		free(map);
+		fclose(f);
+		return 0;
+	}
+	map->region[0] = map_unmapped;
+	map->count = 1;
+	map->refs = 1;
+
+	while( fgets(buf, sizeof(buf), f) ){
+		char *tok[16], *t;
+		int ntok = 0;
+		unsigned int width = 2, row = 2048, page;
+		mem_region r = map_unmapped;
+		const char *err = 0;
+
+		line++;
+		if( (t = strchr(buf, '#')) )
+			*t = 0;
+		for( t = strtok(buf, " \t\r\n"); t && ntok < 16; t = strtok(0, " \t\r\n") )
+			tok[ntok++] = t;
+		if( ntok == 0 )
+			continue;
+		if( ntok < 4 )
+			err = "expected <name> <base> <size> <type>";
+		else if( map->count == TMS62X_MAP_REGIONS )
+			err = "too many regions";
+		if( err )
+			goto fail;
+
+		memset(r.name, 0, sizeof(r.name));
+		strncpy(r.name, tok[0], sizeof(r.name) - 1);
+		r.base = strtoul(tok[1], 0, 0);
+		r.size = strtoul(tok[2], 0, 0);
+		r.row_miss = 6;
+
+		if( !strcmp(tok[3], "ram") )
+			r.type = MAP_RAM;
+		else if( !strcmp(tok[3], "sdram") )
+			r.type = MAP_SDRAM;
+		else if( !strcmp(tok[3], "reserved") )
+			r.type = MAP_RESERVED;
+		else{
+			err = "unknown region type";
+			goto fail;
+		}
+
+		for( int i = 4; i < ntok; i++ ){
+			char *val = strchr(tok[i], '=');
+			unsigned int v;
+
+			if( !val ){
+				err = "expected <param>=<value>";
+				goto fail;
+			}
+			*val++ = 0;
+			v = strtoul(val, 0, 0);
+
+			if( !strcmp(tok[i], "wait") )
+				r.wait = v;
+			else if( !strcmp(tok[i], "banks") )
+				r.banks = v;
+			else if( !strcmp(tok[i], "width") )
+				width = v;
+			else if( !strcmp(tok[i], "row") )
+				row = v;
+			else if( !strcmp(tok[i], "rowmiss") )
+				r.row_miss = v;
+			else{
+				err = "unknown parameter";
+				goto fail;
+			}
+		}
+
+		if( !r.size || ((r.base | r.size) & (MAP_PAGE_SIZE - 1)) || r.base + r.size - 1 < r.base )
+			err = "base and size must be multiples of the page size";
+		else if( !r.banks || r.banks > 32 || (r.banks & (r.banks - 1)) || !width || (width & (width - 1)) ||
+				!row || (row & (row - 1)) )
+			err = "banks, width and row must be powers of two";
+		if( err )
+			goto fail;
+
+		r.bank_shift = __builtin_ctz(width);
+		r.row_shift = __builtin_ctz(row);
+
+		for( page = r.base >> MAP_PAGE_SHIFT; page <= (r.base + r.size - 1) >> MAP_PAGE_SHIFT; page++ ){
+			if( map->page[page] ){
+				err = "region overlaps another one";
+				goto fail;
+			}
+			map->page[page] = map->count;
+		}
+
+		map->banked |= r.banks > 1;
+		map->region[map->count++] = r;
+		continue;
+
+	fail:
+		map_error(name, line, err);
+		fclose(f);
+		map_release(map);
+		return 0;
+	}
+
+	fclose(f);
+	return map;
+}
+
+void map_release(tms62x_map *map){
+
+	if( map && __sync_sub_and_fetch(&map->refs, 1) == 0 ){
+		free(map->page);
+		free(map);
+	}
+}
+
+/* Reads the map named by TMS62X_MEMMAP on the first call. An invalid file
+   stops the simulator. */
+static tms62x_map *map_read_default(){
+
+	char *env = getenv("TMS62X_MEMMAP");
+	tms62x_map *map;
+
+	if( !env )
+		return 0;
+
+	if( !(map = map_load(env)) )
+		exit(1);
+
+	return map;
+}
+
+tms62x_map *map_default(){
+
+	static tms62x_map *map = map_read_default();
+
+	if( map )
+		__sync_add_and_fetch(&map->refs, 1);
+
+	return map;
+}
+
+/* Prints the bank conflict stalls of every execute packet, most stalled first */
+void bank_report(){
+
+	std::vector<std::pair<long long, unsigned int> > list;
+	long long total = 0;
+
+	for( std::map<unsigned int, long long>::iterator i = bank_conflicts.begin(); i != bank_conflicts.end(); i++ ){
+		list.push_back(std::make_pair(-i->second, i->first));
+		total += i->second;
+	}
+	std::sort(list.begin(), list.end());
+
+	fprintf(ac_err, "Bank conflicts: %lld stall cycles\n", total);
+	for( unsigned int i = 0; i < list.size(); i++ )
+		fprintf(ac_err, "  %#010x  %lld\n", list[i].second, -list[i].first);
+}
+
+/* Storage of the mapped regions beyond the memory image */
+unsigned char *mem_host(tms62x_ctx *c, unsigned int addr, unsigned int size){
+
+	unsigned char **table, **page;
+	tms62x_map *map = c->map;
+	int region;
+
+	if( addr + size <= c->mem_size && addr + size >= addr )
+		return c->mem + addr;
+
+	//Beyond the image only the pages of the regions of the map hold data
+	if( !map || (addr & (MAP_PAGE_SIZE - 1)) + size > MAP_PAGE_SIZE || addr < c->mem_size )
+		return 0;
+	region = map->page[addr >> MAP_PAGE_SHIFT];
+	if( !region || map->region[region].type == MAP_RESERVED )
+		return 0;
+
+	if( !c->ext && !(c->ext = (unsigned char ***)calloc(MAP_DIR_SIZE, sizeof(unsigned char **))) )
+		return 0;
+	table = c->ext[addr >> MAP_DIR_SHIFT];
+	if( !table && !(table = c->ext[addr >> MAP_DIR_SHIFT] = (unsigned char **)calloc(MAP_TABLE_SIZE, sizeof(unsigned char *))) )
+		return 0;
+	page = &table[(addr >> MAP_PAGE_SHIFT) & (MAP_TABLE_SIZE - 1)];
+	if( !*page && !(*page = (unsigned char *)calloc(MAP_PAGE_SIZE, 1)) )
+		return 0;
+
+	return *page + (addr & (MAP_PAGE_SIZE - 1));
+}
+
+void ext_free(tms62x_ctx *c){
+
+	if( !c->ext )
+		return;
+
+	for( unsigned int d = 0; d < MAP_DIR_SIZE; d++ )
+		if( c->ext[d] ){
+			for( unsigned int p = 0; p < MAP_TABLE_SIZE; p++ )
+				free(c->ext[d][p]);
+			free(c->ext[d]);
+		}
+	free(c->ext);
+	c->ext = 0;
+}
+
+int ext_copy(tms62x_ctx *dst, const tms62x_ctx *src){
+
+	ext_free(dst);
+	if( !src->ext )
+		return 1;
+
+	if( !(dst->ext = (unsigned char ***)calloc(MAP_DIR_SIZE, sizeof(unsigned char **))) )
+		return 0;
+
+	for( unsigned int d = 0; d < MAP_DIR_SIZE; d++ ){
+		if( !src->ext[d] )
+			continue;
+		if( !(dst->ext[d] = (unsigned char **)calloc(MAP_TABLE_SIZE, sizeof(unsigned char *))) )
+			return 0;
+		for( unsigned int p = 0; p < MAP_TABLE_SIZE; p++ ){
+			if( !src->ext[d][p] )
+				continue;
+			if( !(dst->ext[d][p] = (unsigned char *)malloc(MAP_PAGE_SIZE)) )
+				return 0;
+			memcpy(dst->ext[d][p], src->ext[d][p], MAP_PAGE_SIZE);
+		}
+	}
+
+	return 1;
+}
+
+/* Records the banks of an interleaved region touched by an access of size
+   bytes, stalling a cycle if an earlier access of the execute packet touched
+   one of them */
+inline void bank_access(int region, unsigned int addr, unsigned int size){
+
+	mem_region &r = ctx->map->region[region];
+	unsigned int first = addr >> r.bank_shift;
+	unsigned int count = ((addr + size - 1) >> r.bank_shift) - first + 1;
+	unsigned long long all = (1ull << r.banks) - 1;
+	unsigned long long banks;
+
+	//Banks from first on, wrapping around
+	banks = (count >= r.banks ? all : (1ull << count) - 1) << (first & (r.banks - 1));
+	banks = (banks | banks >> r.banks) & all;
+
+	if( ctx->ep_region != region ){
+		ctx->ep_region = region;
+		ctx->ep_banks = 0;
+	}
+	else if( ctx->ep_banks & banks ){
+		mem_stall(1);
+		if( detailed ){
+			ctx->stats.bank_stalls++;
+			if( ctx == &main_ctx )
+				bank_conflicts[ctx->ep_pc]++;
+		}
+	}
+
+	ctx->ep_banks |= banks;
+}
+
+/* Charges the cycles of an access of size bytes to addr: bank conflicts,
+   cache misses and, when it reaches the memory, the wait states of its
+   region. first is the cache level of the access, CACHE_L1P or CACHE_L1D.
+   A store that misses every cache level reaches the memory and pays its wait
+   states, as every store does with no cache. */
+void mem_timing(int first, unsigned int addr, unsigned int size, int write){
+
+	int region = ctx->map ? ctx->map->page[addr >> MAP_PAGE_SHIFT] : 0;
+	const mem_region &r = ctx->map ? ctx->map->region[region] : map_unmapped;
+	int wait = r.wait;
+
+	if( r.type == MAP_RESERVED )
+		mem_fault(addr);
+
+	if( r.banks > 1 && first == CACHE_L1D )
+		bank_access(region, addr, size);
+
+	if( ctx->cache && !cache_access(first, addr, write) )
+		return;
+
+	if( r.type == MAP_SDRAM ){
+		unsigned int row = (addr >> r.row_shift) + 1;
+
+		if( ctx->open_row[region] != row ){
+			ctx->open_row[region] = row;
+			wait += r.row_miss;
+		}
+	}
+
+	mem_stall(wait);
+}
+
+/* Event queue. Peripherals post timed events to the queue of their core
+   instead of being polled. The instruction loop only looks at the queue
+   when the cycle count reaches the earliest event, and an idle core skips
+   directly to it. */
+
+/* Posts an event of kind, with arg, for cycle when */
+void evq_post(long long when, int kind, int arg){
+
+	event_queue &q = ctx->evq;
+	int n, i;
+
+	if( q.count == EVQ_SIZE ){
+		cerr << "Event queue full." << endl;
+		exit(1);
+	}
+
+	n = q.nfree ? q.free[--q.nfree] : q.used++;
+	q.node[n].when = when;
+	q.node[n].kind = kind;
+	q.node[n].arg = arg;
+
+	//Sifting up from a new leaf
+	for( i = q.count++; i > 0 && q.node[q.heap[(i - 1) / 2]].when > when; i = (i - 1) / 2 )
+		q.heap[i] = q.heap[(i - 1) / 2];
+	q.heap[i] = n;
+
+	q.next = q.node[q.heap[0]].when;
+}
+
+/* Removes the earliest event and returns it */
+sim_event evq_pop(){
+
+	event_queue &q = ctx->evq;
+	int top = q.heap[0], last = q.heap[--q.count];
+	int i = 0, c;
+	sim_event ev = q.node[top];
+
+	q.free[q.nfree++] = top;
+
+	//Sifting the last leaf down from the root
+	while( (c = 2 * i + 1) < q.count ){
+		if( c + 1 < q.count && q.node[q.heap[c + 1]].when < q.node[q.heap[c]].when )
+			c++;
+		if( q.node[q.heap[c]].when >= q.node[last].when )
+			break;
+		q.heap[i] = q.heap[c];
+		i = c;
+	}
+	q.heap[i] = last;
+
+	return ev;
+}
+
+/* Advances the cycle count to the earliest event, if any, as an idle core
+   does, but not past limit when it is not negative */
+void evq_skip(long long limit){
+
+	long long skip = (limit >= 0 && limit < ctx->evq.next ? limit : ctx->evq.next) - ctx->cycle_count;
+
+	if( ctx->evq.count && skip > 0 ){
+		ctx->cycle_count += skip;
+		if( detailed )
+			ctx->stats.cycles += skip;
+	}
+}
+
+/* EDMA controller. The transfers are done with bulk copies in the memory
+   image: each synchronization event moves its whole unit (an element or a
+   frame of a 1-D transfer, an array or the whole block of a 2-D one) at
+   once, and the channel is busy until its EV_EDMA event, posted for the
+   modeled transfer time. Then the completion of the transfer, if it was the
+   last unit, sets the channel interrupt, chains to the channel given by TCC
+   and links the next parameter entry. The registers are reached with word
+   loads and stores at EDMA_BASE. */
+/* Host address of len bytes at addr, in the memory or the shared region.
+   Returns NULL if they are not contiguous on the host, which only happens
+   for ranges that cross a page beyond the memory image. */
+unsigned char *edma_host(unsigned int addr, unsigned int len){
+
+	tms62x_shared *sh = ctx->shared;
+
+	if( sh && addr - sh->base < sh->size && addr - sh->base + len <= sh->size )
+		return sh->data + (addr - sh->base);
+
+	return mem_host(ctx, addr, len);
+}
+
+/* Host address of an element at addr */
+unsigned char *edma_ptr(unsigned int addr, unsigned int len){
+
+	unsigned char *p = edma_host(addr, len);
+
+	if( !p ){
+		cerr << "EDMA transfer out of bounds: " << hex << addr << dec << endl;
+		exit(1);
+	}
+
+	return p;
+}
+
+/* Address step between the elements of a frame, for an address mode */
+inline int edma_step(int mode, int es, int eleidx){
+
+	static const int sign[3] = { 0, 1, -1 };
+
+	return mode == 3 ? eleidx : sign[mode] * es;
+}
+
+/* Address of the first element of the next frame, from the first and the
+   last elements of the current one */
+inline unsigned int edma_next_frame(int two_d, int mode, unsigned int first, unsigned int last,
+																		int es, int frmidx){
+
+	if( two_d )
+		return first + frmidx;
+
+	return mode == 3 ? last + frmidx : last + edma_step(mode, es, 0);
+}
+
+/* Moves the unit of one synchronization event of channel ch and updates its
+   parameters. Returns the number of elements moved. */
+unsigned int edma_transfer(int ch){
+
+	unsigned int *p = &ctx->edma.param[ch * EDMA_ENTRY_WORDS];
+	unsigned int opt = p[EDMA_OPT];
+	unsigned int src = p[EDMA_SRC], dst = p[EDMA_DST];
+	unsigned int elecnt = p[EDMA_CNT] & 0xFFFF, frmcnt = p[EDMA_CNT] >> 16;
+	int eleidx = (short)p[EDMA_IDX], frmidx = (short)(p[EDMA_IDX] >> 16);
+	int es = 4 >> EDMA_OPT_ESIZE(opt);
+	int two_s = EDMA_OPT_2DS(opt), two_d = EDMA_OPT_2DD(opt);
+	int sum = EDMA_OPT_SUM(opt), dum = EDMA_OPT_DUM(opt);
+	int sstep = edma_step(sum, es, eleidx), dstep = edma_step(dum, es, eleidx);
+	bool whole = EDMA_OPT_FS(opt) || two_s || two_d;  //Events move whole frames
+	unsigned int moved = 0;
+
+	if( !es ){
+		cerr << "EDMA ERROR! Invalid element size in channel " << ch << endl;
+		exit(1);
+	}
+
+	//A finished transfer that was not linked moves nothing
+	ctx->edma.last &= ~(1u << ch);
+	if( !elecnt )
+		return 0;
+
+	do {
+		unsigned int n = whole ? elecnt : 1;
+		unsigned char *d, *s;
+
+		if( sstep == es && dstep == es && (d = edma_host(dst, n * es)) && (s = edma_host(src, n * es)) )
+			memmove(d, s, n * es);
+		else
+			for( unsigned int i = 0; i < n; i++ )
+				memmove(edma_ptr(dst + i * dstep, es), edma_ptr(src + i * sstep, es), es);
+
+		moved += n;
+		if( elecnt > n ){
+			//Element synchronized frame in progress
+			elecnt--;
+			src += sstep;
+			dst += dstep;
+			break;
+		}
+
+		if( frmcnt == 0 ){
+			//Last frame: the transfer ends with this unit
+			ctx->edma.last |= 1u << ch;
+			elecnt = 0;
+			break;
+		}
+
+		frmcnt--;
+		src = edma_next_frame(two_s, sum, src, src + (n - 1) * sstep, es, frmidx);
+		dst = edma_next_frame(two_d, dum, dst, dst + (n - 1) * dstep, es, frmidx);
+		elecnt = whole ? p[EDMA_CNT] & 0xFFFF : p[EDMA_RLD] >> 16;
+
+	//A frame synchronized 2-D event moves every array
+	} while( EDMA_OPT_FS(opt) && (two_s || two_d) );
+
+	p[EDMA_SRC] = src;
+	p[EDMA_DST] = dst;
+	p[EDMA_CNT] = (frmcnt << 16) | elecnt;
+
+	return moved;
+}
+
+/* Starts the transfers of the channels with a pending event that are not busy */
+void edma_service(){
+
+	tms62x_edma &e = ctx->edma;
+	unsigned int ready = e.trig & ~e.busy;
+
+	while( ready ){
+		int ch = __builtin_ctz(ready);
+
+		ready &= ready - 1;
+		e.trig &= ~(1u << ch);
+		e.er &= ~(1u << ch);
+		e.busy |= 1u << ch;
+		evq_post(ctx->cycle_count + EDMA_SETUP + edma_transfer(ch), EV_EDMA, ch);
+	}
+}
+
+/* EV_EDMA handler: the transfer in flight of channel ch ends. Starts the
+   pending ones. */
+void edma_done(int ch){
+
+	tms62x_edma &e = ctx->edma;
+
+	e.busy &= ~(1u << ch);
+
+	if( e.last & (1u << ch) ){
+		unsigned int *p = &e.param[ch * EDMA_ENTRY_WORDS];
+		unsigned int opt = p[EDMA_OPT];
+		unsigned int tcc = EDMA_OPT_TCC(opt);
+
+		e.last &= ~(1u << ch);
+
+		if( EDMA_OPT_TCINT(opt) ){
+			e.cipr |= 1u << tcc;
+			if( e.cier & (1u << tcc) )
+				ctx->RB_C[IFR] |= 1 << EDMA_INT;
+
+			//Chaining: the completion is an event of channel TCC
+			if( e.ccer & (1u << tcc) ){
+				e.er |= 1u << tcc;
+				e.trig |= e.er & e.eer & (1u << tcc);
+			}
+		}
+
+		//Linking: the next transfer of the channel is taken from the link entry
+		if( EDMA_OPT_LINK(opt) ){
+			unsigned int link = (p[EDMA_RLD] & 0xFFFF) & (EDMA_PARAM_SIZE - 1);
+
+			if( link + EDMA_ENTRY_WORDS * 4 <= EDMA_PARAM_SIZE )
+				memcpy(p, &e.param[link / 4], EDMA_ENTRY_WORDS * 4);
+		}
+	}
+
+	edma_service();
+}
+
+//Event handlers, indexed by kind
+void (*const ev_handler[])(int arg) = { edma_done };
+
+/* Runs the events that are due */
+void evq_run(){
+
+	event_queue &q = ctx->evq;
+
+	while( q.count && q.node[q.heap[0]].when <= ctx->cycle_count ){
+		sim_event ev = evq_pop();
+
+		ev_handler[ev.kind](ev.arg);
+	}
+
+	q.next = q.count ? q.node[q.heap[0]].when : EVQ_NONE;
+}
+
+/* Reads an EDMA register or parameter word */
+unsigned int edma_read(unsigned int off){
+
+	tms62x_edma &e = ctx->edma;
+
+	if( off < EDMA_PARAM_SIZE )
+		return e.param[off / 4];
+
+	switch( off & ~3u ){
+	case EDMA_CIPR: return e.cipr;
+	case EDMA_CIER: return e.cier;
+	case EDMA_CCER: return e.ccer;
+	case EDMA_ER:   return e.er;
+	case EDMA_EER:  return e.eer;
+	}
+
+	return 0;
+}
+
+/* Writes an EDMA register or parameter word */
+void edma_write(unsigned int off, unsigned int value){
+
+	tms62x_edma &e = ctx->edma;
+
+	value &= off < EDMA_PARAM_SIZE ? ~0u : (1u << EDMA_CHANNELS) - 1;
+
+	if( off < EDMA_PARAM_SIZE ){
+		e.param[off / 4] = value;
+		return;
+	}
+
+	switch( off & ~3u ){
+	case EDMA_CIPR: e.cipr &= ~value; break;
+	case EDMA_CIER: e.cier = value; break;
+	case EDMA_CCER: e.ccer = value; break;
+	case EDMA_ECR:  e.er &= ~value; break;
+	case EDMA_EER:
+		e.eer = value;
+		e.trig |= e.er & e.eer;
+		break;
+	case EDMA_ESR:
+		e.er |= value;
+		e.trig |= value;
+		break;
+	}
+
+	edma_service();
+}
+
+inline unsigned char *mem_at(unsigned addr, unsigned size, int write){
+
+	tms62x_shared *sh = ctx->shared;
+	unsigned char *m;
+
+	if( sh && addr - sh->base < sh->size ){
+		if( addr - sh->base + size > sh->size )
+			mem_fault(addr);
+		shared_arbitrate(sh, ctx->core_id, ctx->cycle_count);
+		return sh->data + (addr - sh->base);
+	}
+
+	if( ctx->cache || ctx->map )
+		mem_timing(CACHE_L1D, addr, size, write);
+
+	if( addr + size <= ctx->mem_size && addr + size >= addr )
+		return ctx->mem + addr;
+
+	if( !(m = mem_host(ctx, addr, size)) )
+		mem_fault(addr);
+
+	return m;
+}
+
+inline unsigned char mem_read_byte(unsigned addr){
+
+	return *mem_at(addr, 1, 0);
+}
+
+inline unsigned short mem_read_half(unsigned addr){
+
+	unsigned char *m = mem_at(addr, 2, 0);
+
+	return (m[0] << 8) | m[1];
+}
+
+inline unsigned int mem_read(unsigned addr){
+
+	tms62x_shared *sh = ctx->shared;
+
+	if( sh && addr - sh->base < IPC_SIZE ){
+		shared_arbitrate(sh, ctx->core_id, ctx->cycle_count);
+		return ipc_read(sh, ctx->core_id, addr - sh->base);
+	}
+
+	if( addr - EDMA_BASE < EDMA_SIZE )
+		return edma_read(addr - EDMA_BASE);
+
+	unsigned char *m = mem_at(addr, 4, 0);
+
+	return (m[0] << 24) | (m[1] << 16) | (m[2] << 8) | m[3];
+}
+
+inline void mem_write_byte(unsigned addr, unsigned char value){
+
+	*mem_at(addr, 1, 1) = value;
+}
+
+inline void mem_write_half(unsigned addr, unsigned short value){
+
+	unsigned char *m = mem_at(addr, 2, 1);
+
+	m[0] = value >> 8;
+	m[1] = value;
+}
+
+inline void mem_write(unsigned addr, unsigned int value){
+
+	tms62x_shared *sh = ctx->shared;
+
+	if( sh && addr - sh->base < IPC_SIZE ){
+		shared_arbitrate(sh, ctx->core_id, ctx->cycle_count);
+		ipc_write(sh, addr - sh->base, value);
+		return;
+	}
+
+	if( addr - EDMA_BASE < EDMA_SIZE ){
+		edma_write(addr - EDMA_BASE, value);
+		return;
+	}
+
+	unsigned char *m = mem_at(addr, 4, 1);
+
+	m[0] = value >> 24;
+	m[1] = value >> 16;
+	m[2] = value >> 8;
+	m[3] = value;
+}
+
+/* Computes the interrupt flags of IFR that are taken when set: the NMI when
+   NMIE is set, and the maskable interrupts enabled in IER when GIE is set
+   too. Must be called whenever CSR or IER is written. */
+void int_update(tms62x_ctx *c){
+
+	unsigned int ier = c->RB_C[IER];
+
+	c->int_enable = 0;
+	if( ier & INT_NMI )
+		c->int_enable = INT_NMI | (c->RB_C[CSR] & CSR_GIE ? ier & INT_MASKABLE : 0);
+}
+
+/* Takes the highest priority interrupt among the pending ones, at the start
+   of the execute packet at ctx->pc: saves the return address, disables the
+   interrupts of its class and jumps to its service fetch packet in the
+   interrupt service table. */
+void int_take(unsigned int pending){
+
+	int n = __builtin_ctz(pending);
+	unsigned int vector = (ctx->RB_C[ISTP] & ~0x3FFu) | (n << 5);
+
+	dprintf("Interrupt %d at pc: %#x\n", n, ctx->pc);
+
+	ctx->RB_C[IFR] &= ~(1 << n);
+	if( n == 1 ){
+		//NMI: NMIE is set again by B NRP
+		ctx->RB_C[NRP] = ctx->pc;
+		ctx->RB_C[IER] &= ~INT_NMI;
+	}
+	else{
+		//The previous GIE is kept in PGIE and restored by B IRP
+		ctx->RB_C[IRP] = ctx->pc;
+		ctx->RB_C[CSR] = (ctx->RB_C[CSR] & ~(CSR_GIE | CSR_PGIE)) | ((ctx->RB_C[CSR] & CSR_GIE) << 1);
+	}
+	ctx->RB_C[ISTP] = vector;  //HPEINT field
+	int_update(ctx);
+
+	ctx->pc = vector;
+}
+
+/* Decodes the AMR register into the addressing mode and block size of every
+   general register of the context. Must be called whenever AMR is written. */
+void amr_decode(tms62x_ctx *c){
+
+	unsigned int amr = c->RB_C[AMR];
+	unsigned int bk[4];
+	int i;
+
+	//The block size is 2^(N+1) bytes, N taken from the BK0 or BK1 field
+	bk[0] = 0;
+	bk[1] = 2u << ((amr >> 16) & 0x1F);
+	bk[2] = 2u << ((amr >> 21) & 0x1F);
+	bk[3] = 0;
+
+	//Only A4-A7 and B4-B7 have a mode field; every other register is linear.
+	memset(c->amr_mode, 0, sizeof(c->amr_mode));
+	memset(c->amr_bksize, 0, sizeof(c->amr_bksize));
+
+	//Mode fields for Reg Bank B start on bit 8, and for Reg Bank A they start on bit 0.
+	for( i = 0; i < 8; i++ ){
+		int reg = ((i & 4) << 2) | 4 | (i & 3);
+		unsigned int mode = (amr >> (i << 1)) & 3;
+
+		c->amr_mode[reg] = mode;
+		c->amr_bksize[reg] = bk[mode];
+	}
+}
+
+/* Checks the addressing mode of a register, as decoded from AMR by amr_decode().
+
+   Returns 0 for linear mode and 1 for circular mode. The block size is stored into the bksize
+   field of the context.
+*/
+inline int checkAMR(int s, int reg){
+
+	int i = (s<<4)|reg;
+
+	if( ctx->amr_mode[i] == 3 ){
+		cout << "CheckAMR ERROR! Invalid value into the mode selection field: 3" << endl;
+		exit(1);
+	}
+
+	ctx->bksize = ctx->amr_bksize[i];
+	return ctx->amr_mode[i] != 0;
+}
+
+/* Circular addressing: only the address bits inside the block of the base
+   register change. bksize was set by checkAMR. */
+inline unsigned circular(unsigned base, unsigned moved){
+
+	unsigned mask = ctx->bksize - 1;
+
+	dprintf("Circular Addressing mode. Block size: %u\n", ctx->bksize);
+	return (base & ~mask) | (moved & mask);
+}
+
+/* Load/store address generation. The addressing mode, the access size and
+   linear/circular addressing are template parameters, so every combination
+   compiles to a few arithmetic operations. The instances of the mode and size
+   of an instruction are picked from ldst_table when its fetch packet is
+   decoded; only the linear or circular one is chosen when it runs.
+
+   Mode bits: 3 modifies the base register, 2 takes the offset from a register
+   (ucst5 otherwise), 1 selects post-modification, 0 adds the offset (subtracts
+   it otherwise). Modes 2, 3, 6 and 7 are invalid. */
+template<int mode, int scale, int circ>
+void ldst_address(int y, int baseR, int offsetR){
+
+	unsigned base = readReg(y, baseR);
+	unsigned offset = ((mode & 4) ? (unsigned)readReg(y, offsetR) : (unsigned)offsetR) << scale;
+	unsigned moved = (mode & 1) ? base + offset : base - offset;
+
+	if( circ )
+		moved = circular(base, moved);
+
+	ctx->address = ((mode & 8) && (mode & 2)) ? base : moved;
+	if( mode & 8 )
+		writeReg(y, baseR, moved);
+}
+
+void ldst_invalid(int, int, int){
+
+	cerr << "Invalid mode for load/store address computation" <<endl;
+	exit(1);
+}
+
+#define LDST_SIZE(m, s) { &ldst_address<m, s, 0>, &ldst_address<m, s, 1> }
+#define LDST_MODE(m)    { LDST_SIZE(m, 0), LDST_SIZE(m, 1), LDST_SIZE(m, 2) }
+#define LDST_INVALID    { { &ldst_invalid, &ldst_invalid }, { &ldst_invalid, &ldst_invalid }, \
+                          { &ldst_invalid, &ldst_invalid } }
+
+//Indexed by addressing mode, access size (log2 of the bytes) and circular mode
+static const ldst_addr_fn ldst_table[16][3][2] = {
+	LDST_MODE(0x0), LDST_MODE(0x1), LDST_INVALID,   LDST_INVALID,
+	LDST_MODE(0x4), LDST_MODE(0x5), LDST_INVALID,   LDST_INVALID,
+	LDST_MODE(0x8), LDST_MODE(0x9), LDST_MODE(0xA), LDST_MODE(0xB),
+	LDST_MODE(0xC), LDST_MODE(0xD), LDST_MODE(0xE), LDST_MODE(0xF)
+};
+
+//Access size (log2 of the bytes) of each ld_st value: ldhu, ldbu, ldb, stb, ldh, sth, ldw, stw
+static const int ldst_scale[8] = { 1, 0, 0, 0, 1, 1, 2, 2 };
+
+#undef LDST_SIZE
+#undef LDST_MODE
+#undef LDST_INVALID
+
+/* Instruction families. The near-identical compare, multiply, shift and
+   address arithmetic instructions share these templates, parameterized by
+   operation, operand width, signedness and half-word selection. */
+
+/* 5-bit signed constant */
+inline int scst5(unsigned int v){
+
+	return (int)(v << 27) >> 27;
+}
+
+/* The unsigned compares take a 4-bit constant in a 5-bit field */
+inline bool ucst4_valid(unsigned int v){
+
+	if( v & 0x10 ){
+		cout << "MSB bit of the cst field is non-zero. Invalid result for this operation." << endl;
+		return false;
+	}
+
+	return true;
+}
+
+enum { CMP_EQ, CMP_GT, CMP_LT };
+
+/* Compares a with b, writing 1 or 0. T selects width and signedness. */
+template<int op, class T>
+inline void cmp_op(int s, int dst, T a, T b){
+
+	writeReg(s, dst, op == CMP_EQ ? a == b : op == CMP_GT ? a > b : a < b);
+}
+
+enum { HALF_LO, HALF_HI };
+
+/* A 16-bit multiplier operand taken from the selected half of v */
+template<int half, int sign>
+inline int mpy_operand(int v){
+
+	unsigned int h = half == HALF_HI ? (unsigned int)v >> 16 : (unsigned int)v & 0xFFFF;
+
+	return sign ? (int)(short)h : (int)h;
+}
+
+/* 16x16-bit multiply of the selected halves of op1 and op2 */
+template<int half1, int sign1, int half2, int sign2>
+inline void mpy_op(int s, int dst, int op1, int op2){
+
+	int a = mpy_operand<half1, sign1>(op1);
+	int b = mpy_operand<half2, sign2>(op2);
+
+	writeReg(s, dst, (int)((unsigned int)a * (unsigned int)b));
+}
+
+enum { SHIFT_LEFT, SHIFT_RIGHT, SHIFT_RIGHTU };
+
+/* Shifts the 32-bit cross path operand or the 40-bit src2 pair by the six
+   LSB of amount; amounts above 39 shift by 40. */
+template<int kind, int src_long, int dst_long>
+inline void shift_op(int s, int dst, int src2, unsigned int amount){
+
+	long long v;
+
+	amount &= 0x3F;
+	amount = amount > 39 ? 40 : amount;
+
+	if( src_long )
+		v = kind == SHIFT_RIGHTU ? (long long)readULong(s, src2) : readLong(s, src2);
+	else
+		v = kind == SHIFT_RIGHTU ? (long long)(unsigned int)ctx->xsrc2 : (long long)ctx->xsrc2;
+
+	if( kind == SHIFT_LEFT )
+		v = (long long)((unsigned long long)v << amount);
+	else if( kind == SHIFT_RIGHT )
+		v >>= amount;
+	else
+		v = (long long)((unsigned long long)v >> amount);
+
+	if( dst_long )
+		writeLong(s, dst, v);
+	else
+		writeReg(s, dst, (int)v);
+}
+
+/* Address arithmetic: adds or subtracts operand, scaled by the access size,
+   to the address in src2, honoring its addressing mode */
+template<int add, int scale>
+inline void adda_op(int s, int dst, int src2, unsigned int operand){
+
+	unsigned base = readReg(s, src2);
+	unsigned offset = operand << scale;
+	unsigned moved = add ? base + offset : base - offset;
+
+	if( checkAMR(s, src2) )
+		moved = circular(base, moved);
+
+	writeReg(s, dst, moved);
+}
+
+/* Adds the statistics in src to dst */
+void add_stats(sim_stats &dst, const sim_stats &src){
+
+	dst.instrs += src.instrs;
+	dst.cycles += src.cycles;
+	for( int i = 0; i < 4; i++ )
+		dst.unit[i] += src.unit[i];
+	dst.loads += src.loads;
+	dst.stores += src.stores;
+	dst.stalls += src.stalls;
+	dst.bank_stalls += src.bank_stalls;
+	for( int i = 0; i < 3; i++ ){
+		dst.hits[i] += src.hits[i];
+		dst.misses[i] += src.misses[i];
+	}
+}
+
+/* Prints a statistics report of context c to ac_err */
+void print_stats(const tms62x_ctx *c, const char *title, const sim_stats &st){
+
+	fprintf(ac_err, "%s\n", title);
+	fprintf(ac_err, "  Instructions: %lld\n", st.instrs);
+	fprintf(ac_err, "  Cycles:       %lld\n", st.cycles);
+	fprintf(ac_err, "  Unit usage:   L %lld  S %lld  M %lld  D %lld\n",
+					st.unit[UNIT_L], st.unit[UNIT_S], st.unit[UNIT_M], st.unit[UNIT_D]);
+	fprintf(ac_err, "  Memory:       %lld loads  %lld stores\n", st.loads, st.stores);
+
+	if( c->cache || c->map )
+		fprintf(ac_err, "  Stalls:       %lld (%lld bank conflicts)\n", st.stalls, st.bank_stalls);
+
+	if( c->cache ){
+		static const char *level[3] = { "L1P", "L1D", "L2" };
+
+		for( int i = 0; i < 3; i++ )
+			if( c->cache->level[i].ways )
+				fprintf(ac_err, "  %-4s          %lld hits  %lld misses\n", level[i], st.hits[i], st.misses[i]);
+	}
+}
+
+/* Changes the simulation mode */
+void set_mode(bool d){
+
+	detailed = d;
+#ifdef DEBUG
+	tracing = d && trace_enabled;
+#endif
+}
+
+/* Waits for one sampling worker and merges its statistics. Returns 0 if there
+   are no workers left. */
+int sample_reap(){
+
+	int status;
+	pid_t pid = wait(&status);
+
+	if( pid < 0 )
+		return 0;
+
+	for( int i = 0; i < sample_jobs; i++ )
+		if( sample_slots[i].pid == pid ){
+			if( WIFEXITED(status) && WEXITSTATUS(status) == 0 ){
+				sim_stats &st = sample_slots[i].st;
+
+				add_stats(sample_total, st);
+				sample_count++;
+
+				if( !simpoints.empty() && st.instrs ){
+					double w = simpoints[sample_slots[i].interval];
+					simpoint_cpi += w * st.cycles / st.instrs;
+					simpoint_weight += w;
+				}
+			}
+			else
+				cerr << "Sampling worker " << pid << " failed." << endl;
+			sample_slots[i].pid = 0;
+		}
+
+	return 1;
+}
+
+/* Called at exit by the functional pass: waits for the remaining workers and
+   prints the merged and extrapolated results. Workers that reach the end of the
+   application only store their partial interval. */
+void sample_report(){
+
+	//A worker whose application ended before its interval did
+	if( sample_slot_id >= 0 ){
+		sample_slots[sample_slot_id].st = ctx->stats;
+		return;
+	}
+
+	while( sample_reap() )
+		;
+
+	if( sample_count == 0 ){
+		cerr << "Sampling: no interval was measured." << endl;
+		return;
+	}
+
+	print_stats(ctx, "Sampled statistics (merged):", sample_total);
+	fprintf(ac_err, "  Intervals:    %d of %lld instructions\n", sample_count, sample_interval);
+	fprintf(ac_err, "  CPI:          %.4f\n", (double)sample_total.cycles / sample_total.instrs);
+	if( simpoint_weight > 0 ){
+		//Weights of the points that were not reached are left out
+		fprintf(ac_err, "  Weighted CPI: %.4f (%.1f%% of the weight measured)\n",
+						simpoint_cpi / simpoint_weight, simpoint_weight * 100);
+		fprintf(ac_err, "  Estimated cycles for %lld instructions: %.0f\n", ctx->insn_count,
+						simpoint_cpi / simpoint_weight * ctx->insn_count);
+	}
+	else
+		fprintf(ac_err, "  Estimated cycles for %lld instructions: %.0f\n", ctx->insn_count,
+						(double)sample_total.cycles / sample_total.instrs * ctx->insn_count);
+}
+
+/* Reads the simulation points file: one "interval weight" pair per line */
+void simpoints_load(const char *name){
+
+	FILE *f = fopen(name, "r");
+	long long interval;
+	double weight;
+
+	if( !f ){
+		perror(name);
+		exit(1);
+	}
+
+	while( fscanf(f, "%lld %lf", &interval, &weight) == 2 )
+		simpoints[interval] = weight;
+
+	fclose(f);
+}
+
+/* Returns true if the interval starting at the current instruction must be measured */
+inline bool sample_here(){
 
+	long long interval = ctx->insn_count / sample_interval;
 
-int xsrc1;  //The cross loaded source operand
-int xsrc2;  //The cross loaded source operand
-unsigned int bksize;     //The value stored in the bk field of the AMR register to be used for the next 
-            //instruction.
-int address; //Used by load/store instructions
+	if( ctx->insn_count % sample_interval != 0 )
+		return false;
 
-/*--------------------------------------------------------------------------------*/
-//User defined functions
+	if( !simpoints.empty() )
+		return simpoints.count(interval) != 0;
 
-/*This function writes a destination register, checking for
-  the correct register bank.*/
-void writeReg( int s, int dst, int value ){
+	return interval % sample_period == 0;
+}
 
-	if (s ){
-		ac_resources::RB_B.write(dst, value );
-		dprintf("Result = %#x (RB_B)\n", ac_resources::RB_B.read(dst));
-	}
-	else{
-		ac_resources::RB_A.write(dst, value );
-		dprintf("Result = %#x (RB_A)\n", ac_resources::RB_A.read(dst));
+/* Reads the sampling configuration. The functional pass does not collect
+   statistics when sampling is enabled. */
+void sample_init(){
+
+	char *env;
+
+	if( (env = getenv("TMS62X_SAMPLE_INTERVAL")) )
+		sample_interval = atoll(env);
+	if( sample_interval <= 0 )
+		return;
+
+	if( (env = getenv("TMS62X_SAMPLE_PERIOD")) )
+		sample_period = atoll(env);
+	if( sample_period <= 0 )
+		sample_period = 1;
+
+	if( (env = getenv("TMS62X_SAMPLE_JOBS")) )
+		sample_jobs = atoi(env);
+	else
+		sample_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	if( sample_jobs <= 0 )
+		sample_jobs = 1;
+
+	if( (env = getenv("TMS62X_SIMPOINTS")) )
+		simpoints_load(env);
+
+	sample_slots = (sample_slot *)mmap(0, sample_jobs * sizeof(sample_slot), PROT_READ | PROT_WRITE,
+																		 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if( sample_slots == MAP_FAILED ){
+		perror("Sampling disabled: mmap");
+		sample_interval = 0;
+		return;
 	}
+	memset(sample_slots, 0, sample_jobs * sizeof(sample_slot));
+
+	set_mode(false);
+	atexit(sample_report);
 }
 
-/* Writes a 40-bit long value to a pair of registers */
-void writeLong(int s, int dst, long long value ){
-	
-	int msb, lsb;  //Most and less significant bits of a 40-bit long value.
+/* Forks a worker that simulates the next interval in detailed mode. */
+void sample_fork(){
 
-	lsb = (value & 0xFFFFFFFF) ;
-	msb = ((value >> 32) & 0xFFFFFFFF);
-	msb = msb & 0x000000FF;
+	int slot;
+	pid_t pid;
 
-	if (s ){
-		ac_resources::RB_B.write(dst, lsb );
-		ac_resources::RB_B.write(dst+1, msb );
-		dprintf("Result = %#x (RB_B(%d))\n", ac_resources::RB_B.read(dst), dst);
-		dprintf("Result = %#x (RB_B(%d))\n", ac_resources::RB_B.read(dst+1), dst+1);
+	//Waiting for a free job slot
+	for(;;){
+		for( slot = 0; slot < sample_jobs; slot++ )
+			if( sample_slots[slot].pid == 0 )
+				break;
+		if( slot < sample_jobs )
+			break;
+		sample_reap();
 	}
-	else{
-		ac_resources::RB_A.write(dst, lsb );
-		ac_resources::RB_A.write(dst+1, msb );
-		dprintf("Result = %#x (RB_A(%d))\n", ac_resources::RB_A.read(dst), dst);
-		dprintf("Result = %#x (RB_A(%d))\n", ac_resources::RB_A.read(dst+1), dst+1);
-	}	
+
+	fflush(NULL);
+	pid = fork();
+
+	if( pid < 0 ){
+		perror("Sampling: fork");
+		return;
+	}
+
+	if( pid == 0 ){
+		//Worker: measure one interval from a clean set of counters
+		sample_slot_id = slot;
+		sample_slots[slot].interval = ctx->insn_count / sample_interval;
+		sample_end = ctx->insn_count + sample_interval;
+		memset(&ctx->stats, 0, sizeof(ctx->stats));
+		set_mode(true);
+		return;
+	}
+
+	sample_slots[slot].pid = pid;
 }
 
+/* Worker only: stores the interval statistics and leaves */
+void sample_finish(){
 
-/*This function reads a source register, checking for
-  the correct register bank.*/
-int readReg( int s, int src ){
+	sample_slots[sample_slot_id].st = ctx->stats;
+	fflush(NULL);
+	_exit(0);
+}
+
+/* Prints the statistics collected in detailed mode */
+void mode_report(){
 
-	if (s ){
-		return (int)ac_resources::RB_B.read(src);
+	print_stats(ctx, "Detailed mode statistics:", ctx->stats);
+}
+
+/* Reads the simulation mode configuration. The sampler drives the mode by
+   itself, so triggers are ignored when sampling is enabled. The library only
+   takes the initial mode. */
+void mode_init(bool standalone){
+
+	char *env;
+	mode_trigger t;
+
+	if( (env = getenv("TMS62X_TRACE")) && atoi(env) == 0 )
+		trace_enabled = false;
+
+	if( sample_interval ){
+		set_mode(detailed);
+		return;
 	}
-	else{
-		return (int)ac_resources::RB_A.read(src);
+
+	if( (env = getenv("TMS62X_MODE")) ){
+		if( !strcmp(env, "fast") )
+			set_mode(false);
+		else if( !strcmp(env, "detailed") )
+			set_mode(true);
+		else{
+			cerr << "Invalid TMS62X_MODE: " << env << endl;
+			exit(1);
+		}
+	}
+	else
+		set_mode(true);
+
+	if( !standalone )
+		return;
+
+	if( (env = getenv("TMS62X_SWITCH")) ){
+		char *list = strdup(env);
+
+		for( char *tok = strtok(list, ","); tok; tok = strtok(0, ",") ){
+			char *val = strchr(tok, ':');
+
+			if( !val ){
+				cerr << "Invalid TMS62X_SWITCH trigger: " << tok << endl;
+				exit(1);
+			}
+			*val++ = 0;
+
+			if( !strcmp(tok, "pc") )
+				t.kind = TRIG_PC;
+			else if( !strcmp(tok, "cycle") )
+				t.kind = TRIG_CYCLE;
+			else if( !strcmp(tok, "insn") )
+				t.kind = TRIG_INSN;
+			else{
+				cerr << "Invalid TMS62X_SWITCH trigger: " << tok << endl;
+				exit(1);
+			}
+			t.value = strtoull(val, 0, 0);
+			triggers.push_back(t);
+		}
+		free(list);
 	}
+
+	if( !detailed || !triggers.empty() )
+		atexit(mode_report);
 }
 
-/* Reads a 40-bit long value */
-long long readLong( int s, int src) {
+/* Fires the triggers reached by the instruction at pc */
+void check_triggers(unsigned pc){
+
+	for( unsigned i = 0; i < triggers.size(); ){
+		mode_trigger &t = triggers[i];
+
+		if( (t.kind == TRIG_PC && pc == t.value) ||
+				(t.kind == TRIG_CYCLE && (unsigned long long)ctx->cycle_count >= t.value) ||
+				(t.kind == TRIG_INSN && (unsigned long long)ctx->insn_count >= t.value) ){
 
-	long long lsrc=0;
-	int msb, lsb;  //Most and less significant bits of a 40-bit long value.
+			set_mode(!detailed);
+			fprintf(ac_err, "Switching to %s mode at pc %#x (instruction %lld, cycle %lld)\n",
+							detailed ? "detailed" : "fast", pc, ctx->insn_count, ctx->cycle_count);
+			triggers.erase(triggers.begin() + i);
+		}
+		else
+			i++;
+	}
+}
 
-	if(s){
-		lsb = ac_resources::RB_B.read(src);
-		msb = ac_resources::RB_B.read(src +1);
+/* Closes the current basic block, adding its instructions to the interval vector */
+inline void bbv_close_block(){
+
+	if( bbv_block_len ){
+		bbv_cur[bbv_block] += bbv_block_len;
+		bbv_block_len = 0;
 	}
-	else{
-		lsb = ac_resources::RB_A.read(src);
-		msb = ac_resources::RB_A.read(src +1);
+}
+
+/* Records one instruction at pc. A basic block starts whenever the
+   instruction does not follow the previous one. */
+inline void bbv_step(unsigned pc){
+
+	if( pc != bbv_next_pc ){
+		bbv_close_block();
+		bbv_block = pc;
+	}
+	bbv_block_len++;
+	bbv_next_pc = pc + 4;
+
+	if( (ctx->insn_count + 1) % bbv_interval == 0 ){
+		bbv_close_block();
+		bbv_list.push_back(bbv_cur);
+		bbv_cur.clear();
 	}
+}
 
-	msb = msb & 0x000000FF;
-	lsrc = msb;
-	lsrc <<= (long long)32;
-	lsrc = lsrc | 0xFFFFFFFF;
-	lsrc = lsrc & lsb;
+//Dimension of the random projection applied to the basic-block vectors
+#define BBV_DIM 15
 
-	return lsrc;
+/* Deterministic pseudo-random projection weight in [-1,1] for a block and dimension */
+inline double bbv_weight(unsigned pc, int d){
+
+	unsigned h = pc * 2654435761u ^ (d + 1) * 40503u;
+
+	h ^= h >> 15;
+	h *= 2246822519u;
+	h ^= h >> 13;
+
+	return (h & 0xFFFF) / 32767.5 - 1.0;
 }
 
+/* Squared euclidean distance between two projected vectors */
+inline double bbv_dist(const double *a, const double *b){
 
-/* Checks the AMR register to determine which address mode must be used and compute the block size.
+	double d = 0;
 
-   Returns 0 for linear mode and 1 for circular mode. The block size is stored into the bksize
-   global variable.
-*/
-int checkAMR(int s, int reg){
+	for( int i = 0; i < BBV_DIM; i++ )
+		d += (a[i] - b[i]) * (a[i] - b[i]);
 
-	sc_int<32> amr;
-	int modefield;
-	int shift;  //Used to adjust the pointer to the correct mode field.
+	return d;
+}
 
-	amr = ac_resources::RB_C.read(AMR);
+/* Clusters the interval vectors with k-means and writes the simulation points */
+void bbv_report(){
 
-	//Mode fields for Reg Bank B start on bit 8, and for Reg Bank A they start on bit 0. The s 
-	//field passed by the instruction is used to select the correct bank.
+	int n, k, i, j, it;
+	const char *name = getenv("TMS62X_BBV_OUTPUT");
+	char *env = getenv("TMS62X_BBV_K");
+	FILE *out;
 
-	if(s)
-		shift = 8;  //Using register bank B
-	else
-		shift = 0;  //Using register bank A
+	//Sampling workers do not report
+	if( sample_slot_id >= 0 )
+		return;
 
-	switch(reg){
-	case 4:			
-		modefield = amr.range(1+shift, 0+shift);
-		break;
-	case 5:
-		modefield = amr.range(3+shift, 2+shift);
-		break;
-	case 6:
-		modefield = amr.range(5+shift, 4+shift);
-		break;
-	case 7:
-		modefield = amr.range(7+shift, 6+shift);
-		break;
-	default:
-		cout << "ERROR. Invalid register used for addressing mode computation: " << reg<< endl;
+	if( !name )
+		name = "tms62x.simpoints";
+
+	n = bbv_list.size();
+	k = env ? atoi(env) : 10;
+	if( k > n )
+		k = n;
+	if( k <= 0 ){
+		cerr << "Phase detection: no complete interval." << endl;
+		return;
 	}
 
-	//Checking the address mode 
-	switch( modefield  ){
-			
-	case 0:
-		//Linear
-		bksize = 0;
-		return 0;
-		break;
-	case 1:
-		//Circular using the BK0 field
+	//Normalized and projected vectors
+	std::vector<double> v(n * BBV_DIM, 0.0);
+	for( i = 0; i < n; i++ ){
+		double *vi = &v[i * BBV_DIM];
+		for( bbv_t::iterator b = bbv_list[i].begin(); b != bbv_list[i].end(); b++ )
+			for( j = 0; j < BBV_DIM; j++ )
+				vi[j] += bbv_weight(b->first, j) * b->second / bbv_interval;
+	}
 
-		//Computing blocksize
-		bksize = 2 << ((unsigned)amr.range(20,16))+1;
-		return 1;
-		break;
-	case 2:
-		//Circular using the BK1 field
-		bksize = 2 << ((unsigned)amr.range(25,21))+1;
-		return 1;
-		break;
-	default:
-		cout << "CheckAMR ERROR! Invalid value into the mode selection field: " << modefield << endl;
-		exit(1);
-		break;
+	//Initial centroids: farthest-point selection starting at the first interval
+	std::vector<double> c(k * BBV_DIM);
+	std::vector<double> near(n, HUGE_VAL);
+	std::vector<int> cl(n, 0);
+	int pick = 0;
+
+	for( j = 0; j < k; j++ ){
+		for( i = 0; i < BBV_DIM; i++ )
+			c[j * BBV_DIM + i] = v[pick * BBV_DIM + i];
+		for( i = 0; i < n; i++ ){
+			double d = bbv_dist(&v[i * BBV_DIM], &c[j * BBV_DIM]);
+			if( d < near[i] )
+				near[i] = d;
+		}
+
+		//The next centroid is the interval farthest from every centroid so far
+		for( i = 0; i < n; i++ )
+			if( near[i] > near[pick] )
+				pick = i;
+	}
+
+	//Lloyd iterations
+	for( it = 0; it < 100; it++ ){
+		bool changed = false;
+
+		for( i = 0; i < n; i++ ){
+			int best = 0;
+			double bestd = HUGE_VAL;
+			for( j = 0; j < k; j++ ){
+				double d = bbv_dist(&v[i * BBV_DIM], &c[j * BBV_DIM]);
+				if( d < bestd ){
+					bestd = d;
+					best = j;
+				}
+			}
+			if( cl[i] != best || it == 0 ){
+				cl[i] = best;
+				changed = true;
+			}
+		}
+
+		if( !changed )
+			break;
+
+		std::vector<int> size(k, 0);
+		std::fill(c.begin(), c.end(), 0.0);
+		for( i = 0; i < n; i++ ){
+			size[cl[i]]++;
+			for( j = 0; j < BBV_DIM; j++ )
+				c[cl[i] * BBV_DIM + j] += v[i * BBV_DIM + j];
+		}
+		for( j = 0; j < k; j++ )
+			for( i = 0; i < BBV_DIM; i++ )
+				if( size[j] )
+					c[j * BBV_DIM + i] /= size[j];
+	}
+
+	//The representative of each cluster is the interval closest to its centroid
+	if( !(out = fopen(name, "w")) ){
+		perror(name);
+		return;
+	}
+
+	for( j = 0; j < k; j++ ){
+		int rep = -1, size = 0;
+		double bestd = HUGE_VAL;
+
+		for( i = 0; i < n; i++ )
+			if( cl[i] == j ){
+				double d = bbv_dist(&v[i * BBV_DIM], &c[j * BBV_DIM]);
+				size++;
+				if( d < bestd ){
+					bestd = d;
+					rep = i;
+				}
+			}
+
+		if( rep >= 0 )
+			fprintf(out, "%d %.6f\n", rep, (double)size / n);
 	}
+
+	fclose(out);
+	cerr << "Phase detection: " << n << " intervals, " << k << " clusters written to " << name << endl;
 }
 
-/* Circular addressing mode */
-inline int circular(int operand){
-	
-	//Circular Addressing mode
-	dprintf("Circular Addressing mode. Block size: \n", bksize);
-	if( (unsigned)operand > bksize ){
-		//So, operand is  operand(mod bksize)
-		operand = operand % bksize;
+/* Reads the phase detection configuration */
+void bbv_init(){
+
+	char *env = getenv("TMS62X_BBV_INTERVAL");
+
+	if( env )
+		bbv_interval = atoll(env);
+
+	if( bbv_interval > 0 )
+		atexit(bbv_report);
+	else
+		bbv_interval = 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+ 
+/* Decodes the eight instructions of the fetch packet in m and finds the
+   execute packets in it from the p-bits: a word begins an execute packet when
+   the p-bit of the previous word is clear. */
+void packet_decode(dec_packet &p, const unsigned char *m){
+
+	unsigned int ep = 1;
+	int i;
+
+	memcpy(p.raw, m, 32);
+
+	for( i = 0; i < 8; i++, m += 4 ){
+		dec_slot &d = p.slot[i];
+		const pred_entry &pred = pred_decode(d.word = (m[0] << 24) | (m[1] << 16) | (m[2] << 8) | m[3]);
+
+		d.id = tms62x_decode(d.word);
+		d.pred_reg = pred.reg;
+		d.pred_annul = pred.annul_nonzero;
+		d.ldst = 0;
+
+		//The address generators of the mode and access size of a load/store
+		if( d.id >= 0 && dec_instrs[d.id].format == DEC_FMT_D_LDST_BaseR ){
+			dec_operands o;
+
+			dec_extractors[DEC_FMT_D_LDST_BaseR](o, d.word);
+			d.ldst = ldst_table[o.mode][ldst_scale[o.ld_st]];
+		}
 	}
 
-	return operand;
+	for( i = 1; i < 8; i++ )
+		ep |= (~p.slot[i-1].word & 1) << i;
+	p.ep = ep;
 }
 
-/* Used by load store to scale the offset accordingly with the data type */
-inline int scale_offset(int ld_st, int offset){
-	
-	if( ld_st == 0x00 || ld_st == 0x04 || ld_st == 0x05){
-		//This is a half-word instruction
-		offset <<=1;
+//The loaded programs, and the lock of the list and of their references
+static tms62x_prog *progs = 0;
+static pthread_mutex_t progs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Returns the program of image, loaded at addr, with a new reference: the one
+   already decoded for the same bytes at the same address, or a new one.
+   Returns 0 if it can not be allocated. */
+tms62x_prog *prog_acquire(const unsigned char *image, unsigned int size, unsigned int addr){
+
+	unsigned long long end = ((unsigned long long)addr + size + 31) & ~31ULL;
+	unsigned char m[32];
+	tms62x_prog *p;
+
+	pthread_mutex_lock(&progs_lock);
+
+	for( p = progs; p; p = p->next )
+		if( p->addr == addr && p->size == size && !memcmp(p->image, image, size) ){
+			__sync_add_and_fetch(&p->refs, 1);
+			pthread_mutex_unlock(&progs_lock);
+			return p;
+		}
+
+	if( !(p = (tms62x_prog *)calloc(1, sizeof(tms62x_prog))) ){
+		pthread_mutex_unlock(&progs_lock);
+		return 0;
 	}
-	else if( ld_st == 0x06 || ld_st == 0x07){
-		//This is a word instruction
-		offset <<=2;
+	p->addr = addr;
+	p->size = size;
+	p->base = addr & ~31u;
+	p->count = (end - p->base) >> 5;
+	p->image = (unsigned char *)malloc(size ? size : 1);
+	p->pkt = (dec_packet *)malloc(p->count ? p->count * sizeof(dec_packet) : 1);
+	if( !p->image || !p->pkt ){
+		free(p->image);
+		free(p->pkt);
+		free(p);
+		pthread_mutex_unlock(&progs_lock);
+		return 0;
+	}
+	memcpy(p->image, image, size);
+
+	//The bytes of the first and last packets outside the image are taken as
+	//zero; fetch_packet() decodes them again if the memory holds others
+	for( unsigned int i = 0; i < p->count; i++ ){
+		unsigned long long a = p->base + 32ULL * i;
+
+		for( int j = 0; j < 32; j++ )
+			m[j] = a + j >= addr && a + j < (unsigned long long)addr + size ? image[a + j - addr] : 0;
+		packet_decode(p->pkt[i], m);
 	}
 
-	return offset;
+	p->refs = 1;
+	p->next = progs;
+	progs = p;
+
+	pthread_mutex_unlock(&progs_lock);
+	return p;
 }
 
-/*--------------------------------------------------------------------------------*/
- 
-//!Generic instruction behavior method.
-void ac_behavior( instruction ){
+/* Takes another reference to a program */
+void prog_retain(tms62x_prog *prog){
 
-	int reg;
+	if( prog )
+		__sync_add_and_fetch(&prog->refs, 1);
+}
 
-	// The PCE1 reg always points to the first instruction in the fetch packet
-	// Notice that this will work if and only if the first instruction of the application is at address 0.
-	if( ac_pc%8 == 0 )
-		RB_C.write(PCE1, ac_pc);
+/* Releases a reference to a program, freeing it with the last one */
+void prog_release(tms62x_prog *prog){
 
-	ac_pc +=4;
+	tms62x_prog **p;
 
-	//Testing Conditional Operations. See details at TMS320C6000 Manual, page 3-16.
-	if( creg == 0 ){
-		if( z != 0 )
-			cerr << "Unknown Condition at pc: " << ac_pc - 4 << endl;
+	if( !prog )
+		return;
+
+	pthread_mutex_lock(&progs_lock);
+	if( __sync_sub_and_fetch(&prog->refs, 1) == 0 ){
+		for( p = &progs; *p != prog; p = &(*p)->next )
+			;
+		*p = prog->next;
+		free(prog->image);
+		free(prog->pkt);
+		free(prog);
+	}
+	pthread_mutex_unlock(&progs_lock);
+}
+
+/* Fetches the fetch packet at addr and gets its decoding: the one of the
+   loaded program while the memory holds the bytes it was decoded from, or
+   else a new one in the context. The PCE1 reg points to the fetch packet.
+   The whole packet is fetched in one memory access, through L1P when there
+   are caches. Returns 0 if the packet is not in the memory. */
+int fetch_packet(unsigned int addr){
+
+	const tms62x_prog *p = ctx->prog;
+	unsigned char *m;
+
+	if( !(m = mem_host(ctx, addr, 32)) ){
+		cerr << "Instruction fetch out of bounds: " << hex << addr << dec << endl;
+		return 0;
 	}
+
+	if( p && (addr - p->base) >> 5 < p->count && !memcmp(p->pkt[(addr - p->base) >> 5].raw, m, 32) )
+		ctx->fp = &p->pkt[(addr - p->base) >> 5];
 	else {
+		packet_decode(ctx->fp_own, m);
+		ctx->fp = &ctx->fp_own;
+	}
 
-		//Getting the register value.
-		switch( creg )
-			{
-			case 1:  //Test register B0
-				reg =  RB_B.read(0);
-				break;
+	ctx->fp_addr = addr;
+	ctx->fp_valid = 1;
+	ctx->RB_C[PCE1] = addr;
 
-			case 2:  //Test register B1
-				reg =  RB_B.read(1);
-				break;
+	if( ctx->cache || ctx->map )
+		mem_timing(CACHE_L1P, addr, 32, 0);
 
-			case 3:  //Test register B2
-				reg =  RB_B.read(2);
-				break;
+	return 1;
+}
 
-			case 4:  //Test register A1
-				reg =  RB_A.read(1);
-				break;
+/* Starts a branch. It is taken after the five execute packets that follow the
+   one of the branch (the delay slots), which may start other branches. */
+inline void branch_to(unsigned int target){
 
-			case 5:  //Test register A2
-				reg =  RB_A.read(2);
-				break;
+	tms62x_branch &b = ctx->br[(ctx->br_head + ctx->br_count) & (TMS62X_BRANCHES - 1)];
 
-			default:
-				cerr << "Unknown Condition register: " << creg << " at pc: " << ac_pc -4 <<endl;
-			}
-				
-		//Testing according to z's  value.
-		if (z){
-			if( reg != 0 )
-				ac_annul(); //Annuling instruction.
-		}
-		else{
-			if( reg == 0 )
-				ac_annul(); //Annuling instruction.
-		}
-	}	
+	if( ctx->br_count == TMS62X_BRANCHES ){
+		cerr << "Too many branches in flight at pc: " << hex << ctx->pc - 4 << dec << endl;
+		exit(1);
+	}
+
+	b.target = target;
+	b.due = ctx->ep_seq + 6;
+	ctx->br_count++;
+}
+
+/* Reads the configuration of the model from the environment, once for the
+   whole process. Sampling, mode switching triggers and phase detection follow
+   the single run of the stand-alone simulator and write process globals, so
+   the library, whose instances run on any number of threads, leaves them out. */
+void model_init(bool standalone){
+
+	if( standalone ){
+		if( main_ctx.map && main_ctx.map->banked )
+			atexit(bank_report);
+		sample_init();
+		bbv_init();
+	}
+	mode_init(standalone);
+}
+
+/* The instruction behaviors. They are members of tms62x_insn, which holds the
+   operand fields of the instruction being executed, as extracted by the
+   generated decoder, so they are run by the instruction loop of the model
+   (ctx_run) on the memory image of the context. The behaviors seen by acsim
+   are at the end of the file. */
+#pragma push_macro("ac_behavior")
+#undef ac_behavior
+#define ac_behavior( name ) name()
+
+struct tms62x_insn : dec_operands {
+
+	int id;        //The instruction, DEC_*
+	int annulled;  //Set when the predicate is false
+	const dec_slot *decoded;  //The instruction in the decoded fetch packet
+
+	const char *get_name(){ return dec_instrs[id].name; }
+
+	void ac_annul(){ annulled = 1; }
+
+//!Generic instruction behavior method.
+void ac_behavior( instruction ){
+
+	//Testing Conditional Operations. See details at TMS320C6000 Manual, page 3-16.
+	//The tested register was resolved from creg and z with the fetch packet.
+	if( decoded->pred_reg >= 0 ){
+		if( pred_annuls(ctx, decoded->pred_reg, decoded->pred_annul) )
+			ac_annul(); //Annuling instruction.
+	}
+	else if( creg != 0 )
+		cerr << "Unknown Condition register: " << creg << " at pc: " << ctx->pc -4 <<endl;
+	else if( z != 0 )
+		cerr << "Unknown Condition at pc: " << ctx->pc - 4 << endl;
 		
 	//Adjusting cycle count	
-	if( p == 0 )
-		cycle_count++;
+	if( p == 0 ){
+		ctx->cycle_count++;
+		if( detailed )
+			ctx->stats.cycles++;
+	}
+
+	if( detailed )
+		ctx->stats.instrs++;
 
 	
 };
@@ -311,50 +2228,50 @@ void ac_behavior( instruction ){
 //! Instruction Format behavior methods.
 void ac_behavior( S_Oper ){
 	
+	if( detailed )
+		ctx->stats.unit[UNIT_S]++;
 
+	load_operands(s, x, src1, src2);
 }
 
 void ac_behavior( D_Oper ){
 
+	if( detailed )
+		ctx->stats.unit[UNIT_D]++;
 }
 
 void ac_behavior( M_Oper ){
 
+	if( detailed )
+		ctx->stats.unit[UNIT_M]++;
+
+	load_operands(s, x, src1, src2);
 }
 
 void ac_behavior( L_Oper ){
 
-	//Getting the second operand. It may be cross loaded from the
-	//register bank that is opposite to the destination reg. 
-  // The s field indicates the destination register bank.
-	if( x )
-		if ( s ){
-			xsrc1 = (int)RB_A.read(src1);
-			xsrc2 = (int)RB_A.read(src2);
-		}
-		else{
-			xsrc1 = (int)RB_B.read(src1);
-			xsrc2 = (int)RB_B.read(src2);
-		}
-	else
-		if ( s ){
-			xsrc1 = (int)RB_B.read(src1);
-			xsrc2 = (int)RB_B.read(src2);
-		}
-		else{
-			xsrc1 = (int)RB_A.read(src1);
-			xsrc2 = (int)RB_A.read(src2);
-		}
+	if( detailed )
+		ctx->stats.unit[UNIT_L]++;
+
+	load_operands(s, x, src1, src2);
 }
 
 void ac_behavior( SK_Oper ){
 
+	if( detailed )
+		ctx->stats.unit[UNIT_S]++;
 }
 
 void ac_behavior( Branch ){
+
+	if( detailed )
+		ctx->stats.unit[UNIT_S]++;
 }
 
 void ac_behavior( K_Oper ){
+
+	if( detailed )
+		ctx->stats.unit[UNIT_S]++;
 }
 
 void ac_behavior( IDLE_Oper ){
@@ -366,134 +2283,32 @@ void ac_behavior( NOP_Oper ){
 //TODO: nonscaled constant offset
 void ac_behavior( D_LDST_BaseR ){
 
-	unsigned offset = 0;
-	unsigned base = readReg(y, baseR);
-	int addrmode;
-
-	//Checking addressing mode
-	addrmode = checkAMR(y, baseR);
-
-	switch (mode){
-	case 0x4:
-		//Negative Offset with offsetR
-		if(addrmode)
-			offset = circular(scale_offset(ld_st, readReg(y, offsetR)));
-		else
-			offset = scale_offset(ld_st, readReg(y, offsetR));
-		address = base - offset; 
-		break;
-	case 0x5:
-		//Positive Offset with offsetR
-		if(addrmode)
-			offset = circular(scale_offset(ld_st, readReg(y, offsetR)));
-		else
-			offset = scale_offset(ld_st, readReg(y, offsetR));
-		address = base + offset; 
-		break;
-	case 0xC:
-		//Predecrement with offsetR
-		if(addrmode)
-			offset = circular(scale_offset(ld_st, readReg(y, offsetR)));
-		else
-			offset = scale_offset(ld_st, readReg(y, offsetR));
-		address = --base + offset;
-		writeReg(y, baseR, base);
-		break;
-	case 0xD:
-		//Preincrement with offsetR
-		if(addrmode)
-			offset = circular(scale_offset(ld_st, readReg(y, offsetR)));
-		else
-			offset = scale_offset(ld_st, readReg(y, offsetR));
-		address = ++base + offset;
-		writeReg(y, baseR, base);
-		break;
-	case 0xE:
-		//Posdecrement with offsetR
-		if(addrmode)
-			offset = circular(scale_offset(ld_st, readReg(y, offsetR)));
-		else
-			offset = scale_offset(ld_st, readReg(y, offsetR));
-		address = base-- + offset;
-		writeReg(y, baseR, base);
-		break;
-	case 0xF:
-		//Posincrement with offsetR
-		if(addrmode)
-			offset = circular(scale_offset(ld_st, readReg(y, offsetR)));
-		else
-			offset = scale_offset(ld_st, readReg(y, offsetR));
-		address = base++ + offset;
-		writeReg(y, baseR, base);
-		break;
-	case 0x0:
-		//Negative Offset with ucst5
-		if(addrmode)
-			offset = circular(scale_offset(ld_st, offsetR));
-		else
-			offset = scale_offset(ld_st, offsetR);
-
-		address = base - offset; 
-		break;
-	case 0x1:
-		//Positive Offset with ucst5
-		offset = scale_offset(ld_st, offsetR);
-		address = base + offset; 
-		break;
-	case 0x8:
-		//Predecrement with ucst5
-		if(addrmode)
-			offset = circular(scale_offset(ld_st, offsetR));
-		else
-			offset = scale_offset(ld_st, offsetR);
-		address = --base + offset;
-		writeReg(y, baseR, base);
-		break;
-	case 0x9:
-		//Preincrement with ucst5
-		if(addrmode)
-			offset = circular(scale_offset(ld_st, offsetR));
-		else
-			offset = scale_offset(ld_st, offsetR);
-		address = ++base + offset;
-		writeReg(y, baseR, base);
-		break;
-	case 0xA:
-		//Posdecrement with ucst5
-		if(addrmode)
-			offset = circular(scale_offset(ld_st, offsetR));
-		else
-			offset = scale_offset(ld_st, offsetR);
-		address = base-- + offset;
-		writeReg(y, baseR, base);
-		break;
-	case 0xB:
-		//Posincrement with ucst5
-		if(addrmode)
-			offset = circular(scale_offset(ld_st, offsetR));
+	if( detailed ){
+		ctx->stats.unit[UNIT_D]++;
+		//Stores have odd ld_st values from 3 up
+		if( ld_st & 1 && ld_st > 1 )
+			ctx->stats.stores++;
 		else
-			offset = scale_offset(ld_st, offsetR);
-		address = base++ + offset;
-		writeReg(y, baseR, base);
-		break;
-	default:
-		cerr << "Invalid mode for load/store address computation" <<endl;
-		exit(1);
-		break;
+			ctx->stats.loads++;
 	}
+
+	//Computing the address (and updating the base register) with the generator
+	//of the addressing mode and access size, linear or circular
+	decoded->ldst[checkAMR(y, baseR)](y, baseR, offsetR);
 }
 
 void ac_behavior( D_LDST_K ){
 
-	unsigned base;
-
-	if( y == 0)
-		base = 14;
-	else
-		base = 15;
+	if( detailed ){
+		ctx->stats.unit[UNIT_D]++;
+		if( ld_st & 1 && ld_st > 1 )
+			ctx->stats.stores++;
+		else
+			ctx->stats.loads++;
+	}
 
-	//Storing the first factor (base address) for address computation.
-	address = readReg(1, base);
+	//The base is B14 or B15 and the 15-bit constant is scaled by the access size
+	ctx->address = readReg(1, 14 + y) + (ucst << ldst_scale[ld_st]);
 }
  
 //!Instruction add_l_iii behavior method.
@@ -501,7 +2316,7 @@ void ac_behavior( add_l_iii ){
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	writeReg(s, dst, ((int)readReg(s, src1) + xsrc2));
+	writeReg(s, dst, ((int)readReg(s, src1) + ctx->xsrc2));
 
 
 }
@@ -516,7 +2331,7 @@ void ac_behavior( add_l_iil ){
   dprintf("%s r%d, r%d, r%d:r%d\n", get_name(), src1, src2, dst+1,dst);
 
 	//Recording the 40-bit long result
-	ldst =  (int) readReg(s, src1) + xsrc2;
+	ldst =  (long long)readReg(s, src1) + ctx->xsrc2;
 
   writeLong( s, dst, ldst );
 }
@@ -532,7 +2347,7 @@ void ac_behavior( add_l_ill ){
 	lsrc2 = readLong( s, src2);
 
 	//Storing result
-	ldst = (int)xsrc1 + lsrc2;
+	ldst = (int)ctx->xsrc1 + lsrc2;
 
 	writeLong(s, dst, ldst);
 	
@@ -575,7 +2390,7 @@ void ac_behavior( addu_iil ){
   dprintf("%s r%d, r%d, r%d:r%d\n", get_name(), src1, src2, dst+1,dst);
 
 	//Recording the 40-bit long result
-	ldst =  (unsigned int) readReg(s, src1) + (unsigned int)xsrc2;
+	ldst =  (long long)(unsigned int)readReg(s, src1) + (unsigned int)ctx->xsrc2;
 
   writeLong( s, dst, ldst );
 
@@ -587,11 +2402,11 @@ void ac_behavior( addu_ill ){
 
   dprintf("%s r%d, r%d:r%d, r%d:r%d\n", get_name(), src1, src2, src2+1, dst, dst+1);
 
-	//Getting the 40-bit second operand
-	lsrc2 = readLong( s, src2);
+	//Getting the 40-bit second operand, unsigned
+	lsrc2 = readULong( s, src2);
 
 	//Recording the 40-bit long result
-	ldst =  (unsigned int) xsrc1 + (unsigned int)lsrc2;
+	ldst =  (unsigned int) ctx->xsrc1 + lsrc2;
 
   writeLong( s, dst, ldst );
 }
@@ -600,14 +2415,14 @@ void ac_behavior( addu_ill ){
 void ac_behavior( sub_l_iii ){ 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	writeReg(s, dst, ((int)readReg(s, src1) - xsrc2));
+	writeReg(s, dst, ((int)readReg(s, src1) - ctx->xsrc2));
 }
 
 //!Instruction sub_l_xiii behavior method.
 void ac_behavior( sub_l_xiii ){
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	writeReg(s, dst, (xsrc1 - (int)readReg(s, src2)));
+	writeReg(s, dst, (ctx->xsrc1 - (int)readReg(s, src2)));
 
 }
 
@@ -618,7 +2433,7 @@ void ac_behavior( sub_l_iil ){
   dprintf("%s r%d, r%d, r%d:r%d\n", get_name(), src1, src2, dst+1,dst);
 
 	//Recording the 40-bit long result
-	ldst =  (int) readReg(s, src1) - xsrc2;
+	ldst =  (long long)readReg(s, src1) - ctx->xsrc2;
 
   writeLong( s, dst, ldst );
 
@@ -631,7 +2446,7 @@ void ac_behavior( sub_l_xiil ){
   dprintf("%s r%d, r%d, r%d:r%d\n", get_name(), src1, src2, dst+1,dst);
 
 	//Recording the 40-bit long result
-	ldst =  xsrc1 - (int) readReg(s, src2);
+	ldst =  (long long)ctx->xsrc1 - readReg(s, src2);
 
   writeLong( s, dst, ldst );
 }
@@ -644,7 +2459,7 @@ void ac_behavior( sub_l_cii ){
 	cst = src1;
   dprintf("%s %d, r%d, r%d\n", get_name(), (int)cst, src2, dst);
 
-	writeReg(s, dst, (int)cst - xsrc2);
+	writeReg(s, dst, (int)cst - ctx->xsrc2);
 
 }
 
@@ -673,7 +2488,7 @@ void ac_behavior( subu_iil ){
   dprintf("%s r%d, r%d, r%d:r%d\n", get_name(), src1, src2, dst+1,dst);
 
 	//Recording the 40-bit long result
-	ldst =  (unsigned int) readReg(s, src1) - (unsigned int)xsrc2;
+	ldst =  (long long)(unsigned int)readReg(s, src1) - (unsigned int)ctx->xsrc2;
 
   writeLong( s, dst, ldst );
 }
@@ -685,7 +2500,7 @@ void ac_behavior( subu_xiil ){
   dprintf("%s r%d, r%d, r%d:r%d\n", get_name(), src1, src2, dst+1,dst);
 
 	//Recording the 40-bit long result
-	ldst =  (unsigned int)xsrc1 - (unsigned int) readReg(s, src2);
+	ldst =  (long long)(unsigned int)ctx->xsrc1 - (unsigned int) readReg(s, src2);
 
   writeLong( s, dst, ldst );
 }
@@ -694,7 +2509,7 @@ void ac_behavior( subu_xiil ){
 void ac_behavior( abs_ii ){
 
   dprintf("%s r%d, r%d\n", get_name(), src2, dst);
-	writeReg(s, dst, abs((int)xsrc2) );
+	writeReg(s, dst, abs((int)ctx->xsrc2) );
 	
 }
 
@@ -705,8 +2520,11 @@ void ac_behavior( abs_ll ){
   dprintf("%s r%d:r%d, r%d:r%d\n", get_name(), src2+1, src2, dst+1,dst);
 
 
-	//Recording the 40-bit long result
+	//Recording the 40-bit long result. The most negative value gives the
+	//largest positive one.
 	ldst =  llabs( readLong(s, src2));
+	if( ldst > MAX_LONG )
+		ldst = MAX_LONG;
 
   writeLong( s, dst, ldst );
 }
@@ -714,194 +2532,75 @@ void ac_behavior( abs_ll ){
 //!Instruction sadd_iii behavior method.
 void ac_behavior( sadd_iii ){ 
 
-	long long aux;
-
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	aux = readReg(s, src1)+ xsrc2;
-
-	//Saturation
-	if( aux > INT_MAX ){
-		writeReg(s, dst, INT_MAX);
-		SATURATE;
-	}
-	else if (aux < INT_MIN ){
-		writeReg(s, dst, INT_MIN);
-		SATURATE;
-	}
-	else
-		writeReg(s, dst, (int) aux);
-		
+	writeReg(s, dst, sat32((long long)readReg(s, src1) + ctx->xsrc2));
 }
 
 //!Instruction sadd_ill behavior method.
 void ac_behavior( sadd_ill ){ 
 
-	long long aux;
-
   dprintf("%s r%d, r%d:r%d, r%d:r%d\n", get_name(), src1, src2+1, src2, dst+1,dst);
 
-	aux = xsrc1 + readLong(s, src2);
-
-	//Saturation
-	if( aux > LONG_MAX ){
-		writeLong(s, dst, LONG_MAX);
-		SATURATE;
-	}
-	else if( aux < LONG_MIN ){
-		writeLong(s, dst, LONG_MIN);
-		SATURATE;
-	}
-	else
-		writeLong(s, dst, aux);
-
+	writeLong(s, dst, sat40(ctx->xsrc1 + readLong(s, src2)));
 }
 
 //!Instruction sadd_cii behavior method.
 void ac_behavior( sadd_cii ){ 
-	long long aux;
 	sc_int<5> cst;
 
   cst = src1;
   dprintf("%s %d, r%d, r%d\n", get_name(), (int)cst, src2, dst);
 
-	aux = cst + xsrc2;
-
-	//Saturation
-	if( aux > INT_MAX ){
-		writeReg(s, dst, INT_MAX);
-		SATURATE;
-	}
-	else if (aux < INT_MIN ){
-		writeReg(s, dst, INT_MIN);
-		SATURATE;
-	}
-	else
-		writeReg(s, dst, (int) aux);
-		
+	writeReg(s, dst, sat32((long long)cst + ctx->xsrc2));
 }
 
 //!Instruction sadd_cll behavior method.
-void ac_behavior( sadd_cll ){ 
-
-
-	long long aux;
+void ac_behavior( sadd_cll ){ 
 	sc_int<5> cst;
 
   dprintf("%s r%d, r%d:r%d, r%d:r%d\n", get_name(), src1, src2+1, src2, dst+1,dst);
 
   cst = src1;
 
-	aux = cst + readLong(s, src2);
-
-	//Saturation
-	if( aux > LONG_MAX ){
-		writeLong(s, dst, LONG_MAX);
-		SATURATE;
-	}
-	else if( aux < LONG_MIN ){
-		writeLong(s, dst, LONG_MIN);
-		SATURATE;
-	}
-	else
-		writeLong(s, dst, aux);
+	writeLong(s, dst, sat40((int)cst + readLong(s, src2)));
 }
 
 //!Instruction ssub_iii behavior method.
 void ac_behavior( ssub_iii ){ 
 
-	long long aux;
-
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	aux = readReg(s, src1)- xsrc2;
-
-	//Saturation
-	if( aux > INT_MAX ){
-		writeReg(s, dst, INT_MAX);
-		SATURATE;
-	}
-	else if (aux < INT_MIN ){
-		writeReg(s, dst, INT_MIN);
-		SATURATE;
-	}
-	else
-		writeReg(s, dst, (int) aux);
-		
-
+	writeReg(s, dst, sat32((long long)readReg(s, src1) - ctx->xsrc2));
 }
 
 //!Instruction ssub_xiii behavior method.
 void ac_behavior( ssub_xiii ){ 
 
-	long long aux;
-
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	aux = xsrc1- readReg(s, src2);
-
-	//Saturation
-	if( aux > INT_MAX ){
-		writeReg(s, dst, INT_MAX);
-		SATURATE;
-	}
-	else if (aux < INT_MIN ){
-		writeReg(s, dst, INT_MIN);
-		SATURATE;
-	}
-	else
-		writeReg(s, dst, (int) aux);
-		
+	writeReg(s, dst, sat32((long long)ctx->xsrc1 - readReg(s, src2)));
 }
 
 //!Instruction ssub_cii behavior method.
 void ac_behavior( ssub_cii ){
-
-	long long aux;
 	sc_int<5> cst;
 
   cst = src1;
   dprintf("%s %d, r%d, r%d\n", get_name(), (int)cst, src2, dst);
 
-	aux = cst - xsrc2;
-
-	//Saturation
-	if( aux > INT_MAX ){
-		writeReg(s, dst, INT_MAX);
-		SATURATE;
-	}
-	else if (aux < INT_MIN ){
-		writeReg(s, dst, INT_MIN);
-		SATURATE;
-	}
-	else
-		writeReg(s, dst, (int) aux);
-		
+	writeReg(s, dst, sat32((long long)cst - ctx->xsrc2));
 }
 
 //!Instruction ssub_cll behavior method.
 void ac_behavior( ssub_cll ){
-
-	long long aux;
 	sc_int<5> cst;
 
   dprintf("%s r%d, r%d:r%d, r%d:r%d\n", get_name(), src1, src2+1, src2, dst+1,dst);
 
   cst = src1;
 
-	aux = cst - readLong(s, src2);
-
-	//Saturation
-	if( aux > LONG_MAX ){
-		writeLong(s, dst, LONG_MAX);
-		SATURATE;
-	}
-	else if( aux < LONG_MIN ){
-		writeLong(s, dst, LONG_MIN);
-		SATURATE;
-	}
-	else
-		writeLong(s, dst, aux);
+	writeLong(s, dst, sat40((int)cst - readLong(s, src2)));
 }
 
 //!Instruction subc behavior method.
@@ -910,7 +2609,7 @@ void ac_behavior( subc ){
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	aux = readReg(s, src1) - xsrc2;
+	aux = readReg(s, src1) - ctx->xsrc2;
 	
 	if( aux >=0 ){
 		aux <<=1;
@@ -926,7 +2625,7 @@ void ac_behavior( subc ){
 void ac_behavior( and_l_iii ){ 
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
-	writeReg( s, dst, readReg(s, src1) & xsrc2 );
+	writeReg( s, dst, readReg(s, src1) & ctx->xsrc2 );
 }
 
 //!Instruction and_l_cii behavior method.
@@ -935,14 +2634,14 @@ void ac_behavior( and_l_cii ){
 
   cst = src1;
   dprintf("%s %d, r%d, r%d\n", get_name(), (int)cst, src2, dst);
-	writeReg( s, dst, (int)cst & xsrc2 );
+	writeReg( s, dst, (int)cst & ctx->xsrc2 );
 	
 }
 
 //!Instruction or_l_iii behavior method.
 void ac_behavior( or_l_iii ){ 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
-	writeReg( s, dst, readReg(s, src1) | xsrc2 );
+	writeReg( s, dst, readReg(s, src1) | ctx->xsrc2 );
 }
 
 //!Instruction or_l_cii behavior method.
@@ -951,14 +2650,14 @@ void ac_behavior( or_l_cii ){
 
   cst = src1;
   dprintf("%s %d, r%d, r%d\n", get_name(), (int)cst, src2, dst);
-	writeReg( s, dst, (int)cst | xsrc2 );
+	writeReg( s, dst, (int)cst | ctx->xsrc2 );
 	
 }
 
 //!Instruction xor_l_iii behavior method.
 void ac_behavior( xor_l_iii ){ 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
-	writeReg( s, dst, readReg(s, src1) ^ xsrc2 );
+	writeReg( s, dst, readReg(s, src1) ^ ctx->xsrc2 );
 }
 
 //!Instruction xor_l_cii behavior method.
@@ -967,7 +2666,7 @@ void ac_behavior( xor_l_cii ){
 
   cst = src1;
   dprintf("%s %d, r%d, r%d\n", get_name(), (int)cst, src2, dst);
-	writeReg( s, dst, (int)cst ^ xsrc2 );
+	writeReg( s, dst, (int)cst ^ ctx->xsrc2 );
 	
 }
 
@@ -975,735 +2674,359 @@ void ac_behavior( xor_l_cii ){
 void ac_behavior( cmpeq_iii ){
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	if( readReg(s, src1) == xsrc2 )
-		writeReg(s, dst, 1);
-	else
-		writeReg(s, dst, 0);
-	
+	cmp_op<CMP_EQ, int>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 //!Instruction cmpeq_cii behavior method.
 void ac_behavior( cmpeq_cii ){
-	sc_int<5> cst;
-
-  cst = src1;
-  dprintf("%s %d, r%d, r%d\n", get_name(), (int)cst, src2, dst);
-
-	if( (int)cst  == xsrc2 )
-		writeReg(s, dst, 1);
-	else
-		writeReg(s, dst, 0);
-	
+  dprintf("%s %d, r%d, r%d\n", get_name(), scst5(src1), src2, dst);
 
+	cmp_op<CMP_EQ, int>(s, dst, scst5(src1), ctx->xsrc2);
 }
 
 //!Instruction cmpeq_ili behavior method.
 void ac_behavior( cmpeq_ili ){
-
   dprintf("%s r%d, r%d:r%d, r%d\n", get_name(), src1, src2+1, src2, dst);
 
-	if( xsrc1 == readLong(s, src2) )
-		writeReg(s, dst, 1);
-	else
-		writeReg(s, dst, 0);
+	cmp_op<CMP_EQ, long long>(s, dst, ctx->xsrc1, readLong(s, src2));
 }
 
 //!Instruction cmpeq_cli behavior method.
 void ac_behavior( cmpeq_cli ){
-	sc_int<5> cst;
-
-  cst = src1;
-  dprintf("%s %d, r%d:r%d, r%d\n", get_name(),  (int)cst, src2+1, src2, dst);
+  dprintf("%s %d, r%d:r%d, r%d\n", get_name(), scst5(src1), src2+1, src2, dst);
 
-	if(  (int)cst == readLong(s, src2) )
-		writeReg(s, dst, 1);
-	else
-		writeReg(s, dst, 0);
+	cmp_op<CMP_EQ, long long>(s, dst, scst5(src1), readLong(s, src2));
 }
 
 //!Instruction cmpgt_iii behavior method.
 void ac_behavior( cmpgt_iii ){
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	if( readReg(s, src1) > xsrc2 )
-		writeReg(s, dst, 1);
-	else
-		writeReg(s, dst, 0);
-	
+	cmp_op<CMP_GT, int>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 //!Instruction cmpgt_cii behavior method.
 void ac_behavior( cmpgt_cii ){
-	sc_int<5> cst;
-
-  cst = src1;
-  dprintf("%s %d, r%d, r%d\n", get_name(), (int)cst, src2, dst);
+  dprintf("%s %d, r%d, r%d\n", get_name(), scst5(src1), src2, dst);
 
-	if( (int)cst  > xsrc2 )
-		writeReg(s, dst, 1);
-	else
-		writeReg(s, dst, 0);
-	
+	cmp_op<CMP_GT, int>(s, dst, scst5(src1), ctx->xsrc2);
 }
 
 //!Instruction cmpgt_ili behavior method.
 void ac_behavior( cmpgt_ili ){
   dprintf("%s r%d, r%d:r%d, r%d\n", get_name(), src1, src2+1, src2, dst);
 
-	if( xsrc1 > readLong(s, src2) )
-		writeReg(s, dst, 1);
-	else
-		writeReg(s, dst, 0);
+	cmp_op<CMP_GT, long long>(s, dst, ctx->xsrc1, readLong(s, src2));
 }
 
 //!Instruction cmpgt_cli behavior method.
 void ac_behavior( cmpgt_cli ){
-	sc_int<5> cst;
-
-  cst = src1;
-  dprintf("%s %d, r%d:r%d, r%d\n", get_name(),  (int)cst, src2+1, src2, dst);
+  dprintf("%s %d, r%d:r%d, r%d\n", get_name(), scst5(src1), src2+1, src2, dst);
 
-	if(  (int)cst > readLong(s, src2) )
-		writeReg(s, dst, 1);
-	else
-		writeReg(s, dst, 0);
+	cmp_op<CMP_GT, long long>(s, dst, scst5(src1), readLong(s, src2));
 }
 
 //!Instruction cmpgtu_iii behavior method.
-void ac_behavior( cmpgtu_iii ){ 
+void ac_behavior( cmpgtu_iii ){
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	if( (unsigned)readReg(s, src1) > (unsigned)xsrc2 )
-		writeReg(s, dst, 1);
-	else
-		writeReg(s, dst, 0);
-	
+	cmp_op<CMP_GT, unsigned int>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 //!Instruction cmpgtu_cii behavior method.
-void ac_behavior( cmpgtu_cii ){ 
-	sc_int<5> cst;
-
-  cst = src1;
-
-  dprintf("%s %d, r%d, r%d\n", get_name(), (int)cst, src2, dst);
+void ac_behavior( cmpgtu_cii ){
+  dprintf("%s %d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	if( cst[4] ){
-		cout << "MSB bit of the cst field is non-zero. Invalid result for this operation." << endl;
-		return;
-	}
-	else{
-		
-		if( (unsigned int)cst.range(3,0)  > (unsigned)xsrc2 )
-			writeReg(s, dst, 1);
-		else
-			writeReg(s, dst, 0);
-	}
+	if( ucst4_valid(src1) )
+		cmp_op<CMP_GT, unsigned int>(s, dst, src1, ctx->xsrc2);
 }
 
 //!Instruction cmpgtu_ili behavior method.
-void ac_behavior( cmpgtu_ili ){ 
+void ac_behavior( cmpgtu_ili ){
   dprintf("%s r%d, r%d:r%d, r%d\n", get_name(), src1, src2+1, src2, dst);
 
-	if( (unsigned)xsrc1 > (unsigned)readLong(s, src2) )
-		writeReg(s, dst, 1);
-	else
-		writeReg(s, dst, 0);
+	cmp_op<CMP_GT, unsigned long long>(s, dst, (unsigned int)ctx->xsrc1, readULong(s, src2));
 }
 
 //!Instruction cmpgtu_cli behavior method.
 void ac_behavior( cmpgtu_cli ){
+  dprintf("%s %d, r%d:r%d, r%d\n", get_name(), src1, src2+1, src2, dst);
 
-	sc_int<5> cst;
-
-  cst = src1;
-
-  dprintf("%s %d, r%d:r%d, r%d\n", get_name(), (int)cst, src2+1, src2,  dst);
-
-	if( cst[4] ){
-		cout << "MSB bit of the cst field is non-zero. Invalid result for this operation." << endl;
-		return;
-	}
-	else{
-		
-		if( (unsigned int)cst.range(3,0)  > (unsigned long long)readLong(s, src2 ))
-			writeReg(s, dst, 1);
-		else
-			writeReg(s, dst, 0);
-	}
+	if( ucst4_valid(src1) )
+		cmp_op<CMP_GT, unsigned long long>(s, dst, src1, readULong(s, src2));
 }
 
 //!Instruction cmplt_iii behavior method.
 void ac_behavior( cmplt_iii ){
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	if( readReg(s, src1) < xsrc2 )
-		writeReg(s, dst, 1);
-	else
-		writeReg(s, dst, 0);
-	
+	cmp_op<CMP_LT, int>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 //!Instruction cmplt_cii behavior method.
-void ac_behavior( cmplt_cii ){ 
-	sc_int<5> cst;
+void ac_behavior( cmplt_cii ){
+  dprintf("%s %d, r%d, r%d\n", get_name(), scst5(src1), src2, dst);
 
-  cst = src1;
-  dprintf("%s %d, r%d, r%d\n", get_name(), (int)cst, src2, dst);
-
-	if( (int)cst  < xsrc2 )
-		writeReg(s, dst, 1);
-	else
-		writeReg(s, dst, 0);
-	
+	cmp_op<CMP_LT, int>(s, dst, scst5(src1), ctx->xsrc2);
 }
 
 //!Instruction cmplt_ili behavior method.
 void ac_behavior( cmplt_ili ){
   dprintf("%s r%d, r%d:r%d, r%d\n", get_name(), src1, src2+1, src2, dst);
 
-	if( xsrc1 < readLong(s, src2) )
-		writeReg(s, dst, 1);
-	else
-		writeReg(s, dst, 0);
+	cmp_op<CMP_LT, long long>(s, dst, ctx->xsrc1, readLong(s, src2));
 }
 
 //!Instruction cmplt_cli behavior method.
 void ac_behavior( cmplt_cli ){
-	sc_int<5> cst;
-
-  cst = src1;
-  dprintf("%s %d, r%d:r%d, r%d\n", get_name(),  (int)cst, src2+1, src2, dst);
+  dprintf("%s %d, r%d:r%d, r%d\n", get_name(), scst5(src1), src2+1, src2, dst);
 
-	if(  (int)cst < readLong(s, src2) )
-		writeReg(s, dst, 1);
-	else
-		writeReg(s, dst, 0);
+	cmp_op<CMP_LT, long long>(s, dst, scst5(src1), readLong(s, src2));
 }
 
 //!Instruction cmpltu_iii behavior method.
 void ac_behavior( cmpltu_iii ){
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	if( (unsigned)readReg(s, src1) < (unsigned)xsrc2 )
-		writeReg(s, dst, 1);
-	else
-		writeReg(s, dst, 0);
+	cmp_op<CMP_LT, unsigned int>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 //!Instruction cmpltu_cii behavior method.
 void ac_behavior( cmpltu_cii ){
-	sc_int<5> cst;
-
-  cst = src1;
-
-  dprintf("%s %d, r%d, r%d\n", get_name(), (int)cst, src2, dst);
+  dprintf("%s %d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	if( cst[4] ){
-		cout << "MSB bit of the cst field is non-zero. Invalid result for this operation." << endl;
-		return;
-	}
-	else{
-		
-		if( (unsigned int)cst.range(3,0)  < (unsigned)xsrc2 )
-			writeReg(s, dst, 1);
-		else
-			writeReg(s, dst, 0);
-	}
+	if( ucst4_valid(src1) )
+		cmp_op<CMP_LT, unsigned int>(s, dst, src1, ctx->xsrc2);
 }
 
 //!Instruction cmpltu_ili behavior method.
 void ac_behavior( cmpltu_ili ){
   dprintf("%s r%d, r%d:r%d, r%d\n", get_name(), src1, src2+1, src2, dst);
 
-	if( (unsigned)xsrc1 < ((unsigned long long)readLong(s, src2) ))
-		writeReg(s, dst, 1);
-	else
-		writeReg(s, dst, 0);
+	cmp_op<CMP_LT, unsigned long long>(s, dst, (unsigned int)ctx->xsrc1, readULong(s, src2));
 }
 
 //!Instruction cmpltu_cli behavior method.
 void ac_behavior( cmpltu_cli ){
-	sc_int<5> cst;
-
-  cst = src1;
+  dprintf("%s %d, r%d:r%d, r%d\n", get_name(), src1, src2+1, src2, dst);
 
-  dprintf("%s %d, r%d:r%d, r%d\n", get_name(), (int)cst, src2+1, src2,  dst);
-
-	if( cst[4] ){
-		cout << "MSB bit of the cst field is non-zero. Invalid result for this operation." << endl;
-		return;
-	}
-	else{
-		
-		if( (unsigned int)cst.range(3,0)  < (unsigned long long)readLong(s, src2 ))
-			writeReg(s, dst, 1);
-		else
-			writeReg(s, dst, 0);
-	}
+	if( ucst4_valid(src1) )
+		cmp_op<CMP_LT, unsigned long long>(s, dst, src1, readULong(s, src2));
 }
 
 
 //!Instruction lmbd_iii behavior method.
 void ac_behavior( lmbd_iii ){ 
 
-	int i;
-	sc_int<32> data;
-
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2,  dst);
 
-	data = xsrc2;
-
-	if( readReg(s, src1) % 2 ==0 ){
-		//Search for the leftmost 0
-		for(i = 31; i>=0; i--)
-			if( data[i] == 0 )
-				break;
-	}
-	else{
-		//Search for the leftmost 1
-		for(i = 31; i>=0; i--)
-			if( data[i] == 1 )
-				break;
-	}
-
-	if( i < 0 ){
-		//Did not find
-			writeReg(s, dst, 32);
-	}
-	else{
-			writeReg(s, dst, 31 - i);
-	}
-		
+	//The LSB of src1 selects the bit value to search for
+	writeReg(s, dst, lmbd(readReg(s, src1), ctx->xsrc2));
 }
 
 //!Instruction lmbd_cii behavior method.
 void ac_behavior( lmbd_cii ){
 
-	int i;
-	sc_int<32> data;
-
   dprintf("%s %d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-
-	data = xsrc2;
-
 	//In this case src1 is a constant.
-	if(  src1 % 2 ==0 ){
-		//Search for the leftmost 0
-		for(i = 31; i>=0; i--)
-			if( data[i] == 0 )
-				break;
-	}
-	else{
-		//Search for the leftmost 1
-		for(i = 31; i>=0; i--)
-			if( data[i] == 1 )
-				break;
-	}
-
-	if( i < 0 ){
-		//Did not find
-			writeReg(s, dst, 32);
-	}
-	else{
-			writeReg(s, dst, 31 - i);
-	}
-		
+	writeReg(s, dst, lmbd(src1, ctx->xsrc2));
 }
 
 //!Instruction norm_ii behavior method.
 void ac_behavior( norm_ii ){ 
 
-	int i;
-	sc_int<32> data;
-
   dprintf("%s r%d, r%d\n", get_name(), src2, dst);
 
-	data = xsrc2;
-	
-	if( data[31] == 0){
-		//Search for the leftmost 1
-		for(i = 30; i>=0; i--)
-			if( data[i] == 1 )
-				break;
-	}
-	else{
-		//Search for the leftmost 0
-		for(i = 30; i>=0; i--)
-			if( data[i] == 0 )
-				break;
-	}
-
-	//writing result
-	if( i < 0 ){
-		//Did not find
-			writeReg(s, dst, 31);
-	}
-	else{
-			writeReg(s, dst, 30 - i);
-	}
-	
+	writeReg(s, dst, norm32(ctx->xsrc2));
 }
 
 //!Instruction norm_li behavior method.
 void ac_behavior( norm_li ){
-	int i;
-	sc_int<40> data;
 
   dprintf("%s r%d:r%d, r%d\n", get_name(), src2+1, src2, dst);
 
-	data = readLong(s, src2);
-	
-	if( data[39] == 0){
-		//Search for the leftmost 1
-		for(i = 38; i>=0; i--)
-			if( data[i] == 1 )
-				break;
-	}
-	else{
-		//Search for the leftmost 0
-		for(i = 38; i>=0; i--)
-			if( data[i] == 0 )
-				break;
-	}
-
-	//writing result
-	if( i < 0 ){
-		//Did not find
-			writeReg(s, dst, 39);
-	}
-	else{
-			writeReg(s, dst, 38 - i);
-	}
-	
+	writeReg(s, dst, norm40(readLong(s, src2)));
 }
 
 //!Instruction sat behavior method.
 void ac_behavior( sat ){ 
 
-	long long aux;
-
-  dprintf("%s r%d, r%d\n", get_name(), src1, src2, dst);
-
-	aux = readLong(s, src2);
-
-	//Saturation
-	if( aux >= INT_MAX ){
-		writeReg(s, dst, INT_MAX);
-		SATURATE;
-	}
-	else if( aux < INT_MIN ){
-		writeReg(s, dst, INT_MIN);
-		SATURATE;
-	}
-	else
-		writeReg(s, dst, aux);
+  dprintf("%s r%d:r%d, r%d\n", get_name(), src2+1, src2, dst);
 
+	writeReg(s, dst, sat32(readLong(s, src2)));
 }
 
 //!Instruction mpy behavior method.
-void ac_behavior( mpy ){ 
-
-	short val1,val2;
+void ac_behavior( mpy ){
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	//Getting the 16 lsb of src1
-	val1 = (short) (readReg(s,src1) & 0xFFFF);
-
-	//Getting the 16 lsb of src2, that may be cross loaded.
-	val2 = (short) (xsrc2 & 0xFFFF);
-
-	writeReg( s, dst, (int)(val1 * val2) );
+	//src2 may be cross loaded
+	mpy_op<HALF_LO, 1, HALF_LO, 1>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 //!Instruction mpy_k behavior method.
-void ac_behavior( mpy_k ){ 
-	short val1, val2;
-	sc_int<5> cst;
+void ac_behavior( mpy_k ){
 
-  cst = src1;
-
-  dprintf("%s %d, r%d, r%d\n", get_name(), cst.to_int(), src2, dst);
-
-	//Getting the 16 lsb of src1
-	val1 = (short) (cst);
+  dprintf("%s %d, r%d, r%d\n", get_name(), scst5(src1), src2, dst);
 
-	//Getting the 16 lsb of src2, that may be cross loaded.
-	val2 = (short) (xsrc2 & 0xFFFF);
-
-	writeReg( s, dst, (int)(val1 * val2) );
+	//src2 may be cross loaded
+	mpy_op<HALF_LO, 1, HALF_LO, 1>(s, dst, scst5(src1), ctx->xsrc2);
 }
 
 //!Instruction mpyu behavior method.
-void ac_behavior( mpyu ){ 
-	unsigned short val1,val2;
+void ac_behavior( mpyu ){
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	//Getting the 16 lsb of src1
-	val1 = (unsigned short) (readReg(s,src1) & 0xFFFF);
-
-	//Getting the 16 lsb of src2, that may be cross loaded.
-	val2 = (unsigned short)(xsrc2 & 0xFFFF);
-
-	writeReg( s, dst, (unsigned int)(val1 * val2) );
-
+	//src2 may be cross loaded
+	mpy_op<HALF_LO, 0, HALF_LO, 0>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 //!Instruction mpyus behavior method.
-void ac_behavior( mpyus ){ 
-	unsigned short val1;
-	short val2;
+void ac_behavior( mpyus ){
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	//Getting the 16 lsb of src1
-	val1 = (unsigned short) (readReg(s,src1) & 0xFFFF);
-
-	//Getting the 16 lsb of src2, that may be cross loaded.
-	val2 = (short)(xsrc2 & 0xFFFF);
-
-	writeReg( s, dst, (int)(val1 * val2) );
-
+	//src2 may be cross loaded
+	mpy_op<HALF_LO, 0, HALF_LO, 1>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 //!Instruction mpysu behavior method.
 void ac_behavior( mpysu ){
-	short val1;
-	unsigned short val2;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	//Getting the 16 lsb of src1
-	val1 = (short) (readReg(s,src1) & 0xFFFF);
-
-	//Getting the 16 lsb of src2, that may be cross loaded.
-	val2 = (unsigned short)(xsrc2 & 0xFFFF);
-
-	writeReg( s, dst, (int)(val1 * val2) );
-
+	//src2 may be cross loaded
+	mpy_op<HALF_LO, 1, HALF_LO, 0>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 //!Instruction mpysu_k behavior method.
 void ac_behavior( mpysu_k ){
-	short val1;
-	unsigned short  val2;
-	sc_int<5> cst;
-
-  cst = src1;
-
-  dprintf("%s %d, r%d, r%d\n", get_name(), cst.to_int(), src2, dst);
-
-	//Getting the 16 lsb of src1
-	val1 = (short) (cst);
 
-	//Getting the 16 lsb of src2, that may be cross loaded.
-	val2 = (unsigned short) (xsrc2 & 0xFFFF);
+  dprintf("%s %d, r%d, r%d\n", get_name(), scst5(src1), src2, dst);
 
-	writeReg( s, dst, (int)(val1 * val2) );
+	//src2 may be cross loaded
+	mpy_op<HALF_LO, 1, HALF_LO, 0>(s, dst, scst5(src1), ctx->xsrc2);
 }
 
 //!Instruction mpyh behavior method.
 void ac_behavior( mpyh ){
 
-	short val1,val2;
-
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	//Getting the 16 msb of src1
-	val1 = (short) ((int)readReg(s,src1) >> 16);
-
-	//Getting the 16 msb of src2, that may be cross loaded.
-	val2 = (short) ((int)xsrc2 >> 16);
-
-	writeReg( s, dst, (int)(val1 * val2) );
+	//src2 may be cross loaded
+	mpy_op<HALF_HI, 1, HALF_HI, 1>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 
 //!Instruction mpyhu behavior method.
 void ac_behavior( mpyhu ){
 
-	short val1,val2;
-
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	//Getting the 16 msb of src1
-	val1 = (unsigned short) ((unsigned int)readReg(s,src1) >> 16);
-
-	//Getting the 16 msb of src2, that may be cross loaded.
-	val2 = (unsigned short) ((unsigned int)xsrc2 >> 16);
-
-	writeReg( s, dst, (unsigned int)(val1 * val2) );
+	//src2 may be cross loaded
+	mpy_op<HALF_HI, 0, HALF_HI, 0>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 
 //!Instruction mpyhus behavior method.
 void ac_behavior( mpyhus ){
 
-	unsigned short val1;
-	short val2;
-
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	//Getting the 16 msb of src1
-	val1 = (unsigned short) ((unsigned int)readReg(s,src1) >> 16);
-
-	//Getting the 16 msb of src2, that may be cross loaded.
-	val2 = (short) ((int)xsrc2 >> 16);
-
-	writeReg( s, dst, (int)(val1 * val2) );
+	//src2 may be cross loaded
+	mpy_op<HALF_HI, 0, HALF_HI, 1>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 
 //!Instruction mpyhsu behavior method.
 void ac_behavior( mpyhsu ){
 
-	short val1;
-	unsigned short val2;
-
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	//Getting the 16 msb of src1
-	val1 = (short) ((int)readReg(s,src1) >> 16);
-
-	//Getting the 16 lsb of src2, that may be cross loaded.
-	val2 = (unsigned short) ((unsigned int)xsrc2 >> 16);
-
-	writeReg( s, dst, (int)(val1 * val2) );
+	//src2 may be cross loaded
+	mpy_op<HALF_HI, 1, HALF_HI, 0>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 
 //!Instruction mpyhl behavior method.
 void ac_behavior( mpyhl ){
-	short val1,val2;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	//Getting the 16 msb of src1
-	val1 = (short) ((int)readReg(s,src1) >> 16);
-
-	//Getting the 16 lsb of src2, that may be cross loaded.
-	val2 = (short) (xsrc2 & 0xFFFF);
-
-	writeReg( s, dst, (int)(val1 * val2) );
+	//src2 may be cross loaded
+	mpy_op<HALF_HI, 1, HALF_LO, 1>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 //!Instruction mpyhlu behavior method.
 void ac_behavior( mpyhlu ){
-	unsigned short val1,val2;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	//Getting the 16 msb of src1
-	val1 = (unsigned short) ((unsigned int)readReg(s,src1) >> 16);
-
-	//Getting the 16 lsb of src2, that may be cross loaded.
-	val2 = (unsigned short) (xsrc2 & 0xFFFF);
-
-	writeReg( s, dst, (unsigned int)(val1 * val2) );
+	//src2 may be cross loaded
+	mpy_op<HALF_HI, 0, HALF_LO, 0>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 //!Instruction mpyhuls behavior method.
 void ac_behavior( mpyhuls ){
-	unsigned short val1;
-	short val2;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	//Getting the 16 msb of src1
-	val1 = (unsigned short) ((unsigned int)readReg(s,src1) >> 16);
-
-	//Getting the 16 lsb of src2, that may be cross loaded.
-	val2 = (short) (xsrc2 & 0xFFFF);
-
-	writeReg( s, dst, (int)(val1 * val2) );
+	//src2 may be cross loaded
+	mpy_op<HALF_HI, 0, HALF_LO, 1>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 //!Instruction mpyhslu behavior method.
 void ac_behavior( mpyhslu ){
-	short val1;
-	unsigned short val2;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	//Getting the 16 msb of src1
-	val1 = (short) ((int)readReg(s,src1) >> 16);
-
-	//Getting the 16 lsb of src2, that may be cross loaded.
-	val2 = (unsigned short) (xsrc2 & 0xFFFF);
-
-	writeReg( s, dst, (int)(val1 * val2) );
+	//src2 may be cross loaded
+	mpy_op<HALF_HI, 1, HALF_LO, 0>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 //!Instruction mpylh behavior method.
 void ac_behavior( mpylh ){
-	short val1,val2;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	//Getting the 16 lsb of src1
-	val1 = (short) (readReg(s,src1) & 0xFFFF );
-
-	//Getting the 16 msb of src2, that may be cross loaded.
-	val2 = (short) ((int)xsrc2 >> 16);
-
-	writeReg( s, dst, (int)(val1 * val2) );
+	//src2 may be cross loaded
+	mpy_op<HALF_LO, 1, HALF_HI, 1>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 //!Instruction mpylhu behavior method.
-void ac_behavior( mpylhu ){ 
-	unsigned short val1,val2;
+void ac_behavior( mpylhu ){
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	//Getting the 16 lsb of src1
-	val1 = (unsigned short) (readReg(s,src1) & 0xFFFF);
-
-	//Getting the 16 msb of src2, that may be cross loaded.
-	val2 = (unsigned short) ((unsigned int)xsrc2>> 16 );
-
-	writeReg( s, dst, (unsigned int)(val1 * val2) );
+	//src2 may be cross loaded
+	mpy_op<HALF_LO, 0, HALF_HI, 0>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 //!Instruction mpyluhs behavior method.
 void ac_behavior( mpyluhs ){
-	unsigned short val1;
-	short val2;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	//Getting the 16 msb of src1
-	val1 = (unsigned short) (readReg(s,src1)& 0xFFFF);
-
-	//Getting the 16 lsb of src2, that may be cross loaded.
-	val2 = (short) ((int)xsrc2  >> 16);
-
-	writeReg( s, dst, (unsigned int)(val1 * val2) );
+	//src2 may be cross loaded
+	mpy_op<HALF_LO, 0, HALF_HI, 1>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 //!Instruction mpylshu behavior method.
-void ac_behavior( mpylshu ){ 
-	short val1;
-	unsigned short val2;
+void ac_behavior( mpylshu ){
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	//Getting the 16 msb of src1
-	val1 = (short) (readReg(s,src1)& 0xFFFF);
-
-	//Getting the 16 lsb of src2, that may be cross loaded.
-	val2 = (unsigned short) ((unsigned int)xsrc2  >> 16);
-
-	writeReg( s, dst, (int)(val1 * val2) );
+	//src2 may be cross loaded
+	mpy_op<HALF_LO, 1, HALF_HI, 0>(s, dst, readReg(s, src1), ctx->xsrc2);
 }
 
 //!Instruction smpy behavior method.
 void ac_behavior( smpy ){
 
 	short val1,val2;
-	int result;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
@@ -1711,16 +3034,9 @@ void ac_behavior( smpy ){
 	val1 = (short) (readReg(s,src1) & 0xFFFF);
 
 	//Getting the 16 lsb of src2, that may be cross loaded.
-	val2 = (short) (xsrc2 & 0xFFFF);
+	val2 = (short) (ctx->xsrc2 & 0xFFFF);
 
-	result = ((int)(val1 * val2))<<1;
-
-	if( result != (int)0x80000000 )
-		writeReg( s, dst, result );
-	else{
-		writeReg( s, dst, 0x7FFFFFFF );
-		SATURATE;
-	}
+	writeReg( s, dst, sat_mpy16(val1, val2) );
 
 }
 
@@ -1728,7 +3044,6 @@ void ac_behavior( smpy ){
 void ac_behavior( smpyh ){
 
 	short val1,val2;
-	int result;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
@@ -1736,16 +3051,9 @@ void ac_behavior( smpyh ){
 	val1 = (short) ((int)readReg(s,src1) >>16);
 
 	//Getting the 16 msb of src2, that may be cross loaded.
-	val2 = (short) ((int)xsrc2 >>16);
-
-	result = ((int)(val1 * val2))<<1;
+	val2 = (short) ((int)ctx->xsrc2 >>16);
 
-	if( result != (int)0x80000000 )
-		writeReg( s, dst, result );
-	else{
-		writeReg( s, dst, 0x7FFFFFFF );
-		SATURATE;
-	}
+	writeReg( s, dst, sat_mpy16(val1, val2) );
 
 }
 
@@ -1753,7 +3061,6 @@ void ac_behavior( smpyh ){
 void ac_behavior( smpyhl ){
 
 	short val1,val2;
-	int result;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
@@ -1761,16 +3068,9 @@ void ac_behavior( smpyhl ){
 	val1 = (short) ((int)readReg(s,src1) >>16);
 
 	//Getting the 16 lsb of src2, that may be cross loaded.
-	val2 = (short) (xsrc2 & 0xFFFF);
+	val2 = (short) (ctx->xsrc2 & 0xFFFF);
 
-	result = ((int)(val1 * val2))<<1;
-
-	if( result != (int)0x80000000 )
-		writeReg( s, dst, result );
-	else{
-		writeReg( s, dst, 0x7FFFFFFF );
-		SATURATE;
-	}
+	writeReg( s, dst, sat_mpy16(val1, val2) );
 
 }
 
@@ -1778,7 +3078,6 @@ void ac_behavior( smpyhl ){
 void ac_behavior( smpylh ){
 
 	short val1,val2;
-	int result;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
@@ -1786,16 +3085,9 @@ void ac_behavior( smpylh ){
 	val1 = (short) (readReg(s,src1)& 0xFFFF);
 
 	//Getting the 16 msb of src2, that may be cross loaded.
-	val2 = (short) ((int)xsrc2  >>16);
-
-	result = ((int)(val1 * val2))<<1;
+	val2 = (short) ((int)ctx->xsrc2  >>16);
 
-	if( result != (int)0x80000000 )
-		writeReg( s, dst, result );
-	else{
-		writeReg( s, dst, 0x7FFFFFFF );
-		SATURATE;
-	}
+	writeReg( s, dst, sat_mpy16(val1, val2) );
 
 }
 
@@ -1820,128 +3112,54 @@ void ac_behavior( add_ici ){
 }
 
 //!Instruction addab_iii behavior method.
-void ac_behavior( addab_iii ){ 
-
-	int mode;
-	int operand1 = (int)readReg(s, src1);
-	
-  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1,  dst);
+void ac_behavior( addab_iii ){
 
-	mode = checkAMR(s, src2);
-
-	if( mode ){
-		circular(operand1);
-	}
+  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
-	//Doing the addition
-	writeReg(s, dst, operand1 + (int)readReg(s, src2));
-	dprintf("Result: %x\n",operand1 + (int)readReg(s, src2));
- }
+	adda_op<1, 0>(s, dst, src2, readReg(s, src1));
+}
 
 //!Instruction addah_iii behavior method.
-void ac_behavior( addah_iii ){ 
+void ac_behavior( addah_iii ){
 
-	int mode;
-	int operand1 = (int)readReg(s, src1);
-	
-  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1,  dst);
-
-	mode = checkAMR(s, src2);
-
-	operand1<<=1;
-
-	if( mode ){
-		circular(operand1);
-	}
-
-
-	//Doing the addition
-	writeReg(s, dst, operand1 + (int)readReg(s, src2));
-	dprintf("Result: %x\n",operand1 + (int)readReg(s, src2));
+  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
+	adda_op<1, 1>(s, dst, src2, readReg(s, src1));
 }
 
 //!Instruction addaw_iii behavior method.
-void ac_behavior( addaw_iii ){ 
-	int mode;
-	int operand1 = (int)readReg(s, src1);
-	
-  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1,  dst);
-
-	mode = checkAMR(s, src2);
-
-	operand1<<=2;
-
-	if( mode ){
-		circular(operand1);
-	}
-
+void ac_behavior( addaw_iii ){
 
-	//Doing the addition
-	writeReg(s, dst, operand1 + (int)readReg(s, src2));
-	dprintf("Result: %x\n",operand1 + (int)readReg(s, src2));
+  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
+	adda_op<1, 2>(s, dst, src2, readReg(s, src1));
 }
 
 //!Instruction addab_ici behavior method.
-void ac_behavior( addab_ici ){ 
-	int mode;
-	unsigned operand1 = (unsigned)src1;
-	
-  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1,  dst);
-
-	mode = checkAMR(s, src2);
-
-	if( mode ){
-		circular(operand1);
-	}
+void ac_behavior( addab_ici ){
 
+  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
-	//Doing the addition
-	writeReg(s, dst, operand1 + (int)readReg(s, src2));
-	dprintf("Result: %x\n",operand1 + (int)readReg(s, src2));
+	//src1 is a 5-bit unsigned constant
+	adda_op<1, 0>(s, dst, src2, src1);
 }
 
 //!Instruction addah_ici behavior method.
 void ac_behavior( addah_ici ){
-	int mode;
-	unsigned operand1 = (unsigned)src1;
-	
-  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1,  dst);
-
-	mode = checkAMR(s, src2);
-
-	operand1<<=1;
-
-	if( mode ){
-		circular(operand1);
-	}
 
+  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
-	//Doing the addition
-	writeReg(s, dst, operand1 + (int)readReg(s, src2));
-	dprintf("Result: %x\n",operand1 + (int)readReg(s, src2));
+	//src1 is a 5-bit unsigned constant
+	adda_op<1, 1>(s, dst, src2, src1);
 }
 
 //!Instruction addaw_ici behavior method.
 void ac_behavior( addaw_ici ){
-	int mode;
-	unsigned operand1 = (unsigned)src1;
-	
-  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1,  dst);
-
-	mode = checkAMR(s, src2);
-
-	operand1<<=2;
-
-	if( mode ){
-		circular(operand1);
-	}
 
+  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
-	//Doing the addition
-	writeReg(s, dst, operand1 + (int)readReg(s, src2));
-	dprintf("Result: %x\n",operand1 + (int)readReg(s, src2));
+	//src1 is a 5-bit unsigned constant
+	adda_op<1, 2>(s, dst, src2, src1);
 }
 
 //!Instruction sub_d_iii behavior method.
@@ -1964,128 +3182,54 @@ void ac_behavior( sub_d_ici ){
 }
 
 //!Instruction subab_iii behavior method.
-void ac_behavior( subab_iii ){ 
-
-	int mode;
-	int operand1 = (int)readReg(s, src1);
-	
-  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1,  dst);
-
-	mode = checkAMR(s, src2);
-
-	if( mode ){
-		circular(operand1);
-	}
+void ac_behavior( subab_iii ){
 
+  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
-	//Doing the addition
-	writeReg(s, dst,  (int)readReg(s, src2) - operand1 );
-	dprintf("Result: %x\n",(int)readReg(s, src2) - operand1);
+	adda_op<0, 0>(s, dst, src2, readReg(s, src1));
 }
 
 //!Instruction subab_ici behavior method.
 void ac_behavior( subab_ici ){
-	int mode;
-	unsigned operand1 = (unsigned) src1;
-	
-  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1,  dst);
-
-	mode = checkAMR(s, src2);
-
-	if( mode ){
-		circular(operand1);
-	}
 
+  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
-	//Doing the addition
-	writeReg(s, dst,  (int)readReg(s, src2) - operand1 );
-	dprintf("Result: %x\n",(int)readReg(s, src2) - operand1);
+	//src1 is a 5-bit unsigned constant
+	adda_op<0, 0>(s, dst, src2, src1);
 }
 
 //!Instruction subah_iii behavior method.
 void ac_behavior( subah_iii ){
 
-	int mode;
-	int operand1 = (int)readReg(s, src1);
-	
-  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1,  dst);
-
-	mode = checkAMR(s, src2);
-
-	operand1 <<=1;
-
-	if( mode ){
-		circular(operand1);
-	}
-
+  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
-	//Doing the addition
-	writeReg(s, dst,  (int)readReg(s, src2) - operand1 );
-	dprintf("Result: %x\n",(int)readReg(s, src2) - operand1);
+	adda_op<0, 1>(s, dst, src2, readReg(s, src1));
 }
 
 //!Instruction subah_ici behavior method.
-void ac_behavior( subah_ici ){ 
-	int mode;
-	unsigned operand1 = (unsigned) src1;
-	
-  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1,  dst);
-
-	mode = checkAMR(s, src2);
-
-	operand1 <<=1;
-
-	if( mode ){
-		circular(operand1);
-	}
+void ac_behavior( subah_ici ){
 
+  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
-	//Doing the addition
-	writeReg(s, dst,  (int)readReg(s, src2) - operand1 );
-	dprintf("Result: %x\n",(int)readReg(s, src2) - operand1);
+	//src1 is a 5-bit unsigned constant
+	adda_op<0, 1>(s, dst, src2, src1);
 }
 
 //!Instruction subaw_iii behavior method.
-void ac_behavior( subaw_iii ){ 
-
-	int mode;
-	int operand1 = (int)readReg(s, src1);
-	
-  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1,  dst);
-
-	mode = checkAMR(s, src2);
-
-	operand1 <<=2;
-
-	if( mode ){
-		circular(operand1);
-	}
+void ac_behavior( subaw_iii ){
 
+  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
-	//Doing the addition
-	writeReg(s, dst,  (int)readReg(s, src2) - operand1 );
-	dprintf("Result: %x\n",(int)readReg(s, src2) - operand1);
+	adda_op<0, 2>(s, dst, src2, readReg(s, src1));
 }
 
 //!Instruction subaw_ici behavior method.
 void ac_behavior( subaw_ici ){
 
-	int mode;
-	unsigned operand1 = (unsigned) src1;
-	
-  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1,  dst);
-
-	mode = checkAMR(s, src2);
-
-	operand1 <<=2;
-
-	if( mode ){
-		circular(operand1);
-	}
+  dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
-	//Doing the addition
-	writeReg(s, dst,  (int)readReg(s, src2) - operand1 );
-	dprintf("Result: %x\n",(int)readReg(s, src2) - operand1);
+	//src1 is a 5-bit unsigned constant
+	adda_op<0, 2>(s, dst, src2, src1);
 }
 
 //!Instruction add_s_iii behavior method.
@@ -2093,7 +3237,7 @@ void ac_behavior( add_s_iii ){
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	writeReg(s, dst, ((int)readReg(s, src1) + (int)xsrc2));
+	writeReg(s, dst, ((int)readReg(s, src1) + (int)ctx->xsrc2));
 
 }
 
@@ -2117,9 +3261,9 @@ void ac_behavior( add2 ){
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
 	lsbsrc1 = 0xFFFF & ((int)readReg(s, src1));
-	lsbsrc2 = 0xFFFF & ((int)xsrc2);
+	lsbsrc2 = 0xFFFF & ((int)ctx->xsrc2);
 	msbsrc1 = ((int)readReg(s, src1)) >> 16;
-	msbsrc2 = ((int)xsrc2) >> 16;
+	msbsrc2 = ((int)ctx->xsrc2) >> 16;
 
 	writeReg(s, dst, ((msbsrc1+msbsrc2) <<16) | ((lsbsrc1+lsbsrc2)&0xFFFF));
 	dprintf("Result: %d\n", ((msbsrc1+msbsrc2) <<16) | ((lsbsrc1+lsbsrc2)&0xFFFF));
@@ -2129,74 +3273,55 @@ void ac_behavior( add2 ){
 //!Instruction clr behavior method.
 void ac_behavior( clr ){ 
 
-	int i;
-	sc_uint<5> lsb, msb;
-	sc_uint<32> field, src2a;
+	unsigned int field, src2a;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 	field = readReg(s, src1);
-	src2a = xsrc2;
 
-	lsb = field.range(9,5);
-	msb = field.range(4,0);
-
-	for( i = (int) lsb; i<= (int)msb; i++)
-		src2a[i] = 0;
+	//The lsb of the field is on bits 9-5 and the msb on bits 4-0
+	src2a = ctx->xsrc2 & ~field_mask((field >> 5) & 0x1F, field & 0x1F);
 
 	writeReg(s, dst, (int)src2a);
 	dprintf("Result: %d\n", (int)src2a);
-	
 }
 
 
 //!Instruction ext behavior method.
 void ac_behavior( ext ){ 
 
-	sc_uint<5> left, right;
-	sc_uint<32> field;
+	unsigned int field;
 	int src2a;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 	field = readReg(s, src1);
-	src2a = xsrc2;
 
-	right = field.range(4,0);
-	left = field.range(9,5);
+	//Left shift amount on bits 9-5, right shift amount on bits 4-0
+	src2a = (int)((unsigned int)ctx->xsrc2 << ((field >> 5) & 0x1F)) >> (field & 0x1F);
 
-	src2a <<= left;
-	(int)src2a >> right; 
-
-	writeReg(s, dst, (int)src2a);
-	dprintf("Result: %d\n", (int)src2a);
-	
+	writeReg(s, dst, src2a);
+	dprintf("Result: %d\n", src2a);
 }
 
 //!Instruction extu behavior method.
 void ac_behavior( extu ){
 
-	sc_uint<5> left, right;
-	sc_uint<32> field;
+	unsigned int field;
 	unsigned int src2a;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 	field = readReg(s, src1);
-	src2a = xsrc2;
 
-	right = field.range(4,0);
-	left = field.range(9,5);
+	//Left shift amount on bits 9-5, right shift amount on bits 4-0
+	src2a = ((unsigned int)ctx->xsrc2 << ((field >> 5) & 0x1F)) >> (field & 0x1F);
 
-	src2a <<= left;
-	(unsigned int)src2a >> right; 
-
-	writeReg(s, dst, (unsigned int)src2a);
-	dprintf("Result: %d\n", (unsigned)src2a);
-	
+	writeReg(s, dst, (int)src2a);
+	dprintf("Result: %d\n", (int)src2a);
 }
 
 //!Instruction and_s_iii behavior method.
 void ac_behavior( and_s_iii ){
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
-	writeReg( s, dst, readReg(s, src1) & xsrc2 );
+	writeReg( s, dst, readReg(s, src1) & ctx->xsrc2 );
 }
 
 //!Instruction and_s_cii behavior method.
@@ -2205,14 +3330,14 @@ void ac_behavior( and_s_cii ){
 
   cst = src1;
   dprintf("%s %d, r%d, r%d\n", get_name(), (int)cst, src2, dst);
-	writeReg( s, dst, (int)cst & xsrc2 );
+	writeReg( s, dst, (int)cst & ctx->xsrc2 );
 	
 }
 
 //!Instruction or_s_iii behavior method.
 void ac_behavior( or_s_iii ){ 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
-	writeReg( s, dst, readReg(s, src1) | xsrc2 );
+	writeReg( s, dst, readReg(s, src1) | ctx->xsrc2 );
 }
 
 //!Instruction or_s_cii behavior method.
@@ -2221,14 +3346,14 @@ void ac_behavior( or_s_cii ){
 
   cst = src1;
   dprintf("%s %d, r%d, r%d\n", get_name(), (int)cst, src2, dst);
-	writeReg( s, dst, (int)cst | xsrc2 );
+	writeReg( s, dst, (int)cst | ctx->xsrc2 );
 	
 }
 
 //!Instruction xor_s_iii behavior method.
 void ac_behavior( xor_s_iii ){
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
-	writeReg( s, dst, readReg(s, src1) ^ xsrc2 );
+	writeReg( s, dst, readReg(s, src1) ^ ctx->xsrc2 );
 }
 
 //!Instruction xor_s_cii behavior method.
@@ -2237,7 +3362,7 @@ void ac_behavior( xor_s_cii ){
 
   cst = src1;
   dprintf("%s %d, r%d, r%d\n", get_name(), (int)cst, src2, dst);
-	writeReg( s, dst, (int)cst ^ xsrc2 );
+	writeReg( s, dst, (int)cst ^ ctx->xsrc2 );
 	
 }
 
@@ -2245,7 +3370,8 @@ void ac_behavior( xor_s_cii ){
 void ac_behavior( mvc_cr ){ 
 
   dprintf("%s r%d, r%d\n", get_name(), src2, dst);
-	writeReg(s, dst, RB_C.read(src2));
+	ctx_fold_sat(ctx);
+	writeReg(s, dst, ctx->RB_C[src2]);
 	
 }
 
@@ -2253,25 +3379,44 @@ void ac_behavior( mvc_cr ){
 void ac_behavior( mvc_rc ){ 
 	
   dprintf("%s r%d, r%d\n", get_name(), src2, dst);
-	RB_C.write( dst, xsrc2 );
+	ctx_fold_sat(ctx);
+
+	switch( dst ){
+	case ISR:
+		//Writes set flags of IFR; ICR writes clear them
+		ctx->RB_C[IFR] |= ctx->xsrc2 & INT_MASKABLE;
+		break;
+	case ICR:
+		ctx->RB_C[IFR] &= ~(ctx->xsrc2 & INT_MASKABLE);
+		break;
+	case IER:
+		//Bit 0 is always set, and NMIE can only be set
+		ctx->RB_C[IER] = 1 | (ctx->xsrc2 & INT_MASKABLE) | ((ctx->RB_C[IER] | ctx->xsrc2) & INT_NMI);
+		break;
+	case ISTP:
+		//Only the table base is written
+		ctx->RB_C[ISTP] = (ctx->RB_C[ISTP] & 0x3FF) | (ctx->xsrc2 & ~0x3FF);
+		break;
+	default:
+		ctx->RB_C[dst] = ctx->xsrc2;
+	}
+
+	if( dst == AMR )
+		amr_decode(ctx);
+	if( dst == CSR || dst == IER )
+		int_update(ctx);
 }
 
 //!Instruction set behavior method.
 void ac_behavior( set_field ){
 
-	int i;
-	sc_uint<5> lsb, msb;
-	sc_uint<32> field, src2a;
+	unsigned int field, src2a;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 	field = readReg(s, src1);
-	src2a = xsrc2;
-
-	lsb = field.range(9,5);
-	msb = field.range(4,0);
 
-	for( i = (int) lsb; i<= (int)msb; i++)
-		src2a[i] = 1;
+	//The lsb of the field is on bits 9-5 and the msb on bits 4-0
+	src2a = ctx->xsrc2 | field_mask((field >> 5) & 0x1F, field & 0x1F);
 
 	writeReg(s, dst, (int)src2a);
 	dprintf("Result: %d\n", (int)src2a);
@@ -2280,292 +3425,146 @@ void ac_behavior( set_field ){
 //!Instruction sshl_iii behavior method.
 void ac_behavior( sshl_iii ){ 
 	unsigned shift;
-	sc_uint<32> aux;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
 	//Five LSB are the shift amount
 	shift = readReg(s, src1)&0x1F;
 
-
-	//Saturation
-	aux = xsrc2;
-	if( ( aux.range(31, 31-shift) == 0) || ( aux.range(31, 31-shift).and_reduce())){
-		writeReg(s, dst, (xsrc2 << shift));
-		dprintf("Result: %d\n", (xsrc2 << shift) );
-	}
-	else if( (int) xsrc2>0 ){
-		writeReg(s, dst, INT_MAX);
-		SATURATE;
-		dprintf("Result: %x\n",  INT_MAX);
-	}
-	else if ((int)xsrc2 < 0 ){
-		writeReg(s, dst, INT_MIN);
-		SATURATE;
-		dprintf("Result: %x\n",  INT_MIN);
-	}
+	writeReg(s, dst, sat_shl32(ctx->xsrc2, shift));
+	dprintf("Result: %d\n", readReg(s, dst));
 }
 
 //!Instruction sshl_ici behavior method.
 void ac_behavior( sshl_ici ){ 
 	unsigned shift;
-	sc_uint<32> aux;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
 	//In this case, src1 is ucst5.
 	shift = src1&0x1F;
 
-	//Saturation
-	aux = xsrc2;
-	if( ( aux.range(31, 31-shift) == 0) || ( aux.range(31, 31-shift).and_reduce())){
-		writeReg(s, dst, (xsrc2 << shift));
-		dprintf("Result: %d\n", (xsrc2 << shift) );
-	}
-	else if( (int) xsrc2>0 ){
-		writeReg(s, dst, INT_MAX);
-		SATURATE;
-		dprintf("Result: %x\n",  INT_MAX);
-	}
-	else if ((int)xsrc2 < 0 ){
-		writeReg(s, dst, INT_MIN);
-		SATURATE;
-		dprintf("Result: %x\n",  INT_MIN);
-	}
+	writeReg(s, dst, sat_shl32(ctx->xsrc2, shift));
+	dprintf("Result: %d\n", readReg(s, dst));
 }
 
 //!Instruction shl_iii behavior method.
-void ac_behavior( shl_iii ){ 
-	unsigned shift;
+void ac_behavior( shl_iii ){
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
-	//Six LSB are the shift amount
-	shift = readReg(s, src1)&0x3F;
-
-	if(shift > 39)
-		shift = 40;
-
-	writeReg(s, dst, (xsrc2 << shift));
-	dprintf("Result: %d\n",  (xsrc2 << shift));
 
+	shift_op<SHIFT_LEFT, 0, 0>(s, dst, src2, readReg(s, src1));
 }
 
 //!Instruction shl_lil behavior method.
 void ac_behavior( shl_lil ){
-	unsigned shift;
-	long long aux;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
-	aux = readLong(s, src2);
-	shift = readReg(s, src1)&0x3F;
-
-	if(shift > 39)
-		shift = 40;
-
-	writeLong(s, dst, (aux << shift));
-	dprintf("Result: %d\n",  (aux << shift));
+	shift_op<SHIFT_LEFT, 1, 1>(s, dst, src2, readReg(s, src1));
 }
 
 //!Instruction shl_iil behavior method.
 void ac_behavior( shl_iil ){
-	unsigned shift;
-	long long aux;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
-	aux = (long long)xsrc2;
-	shift = readReg(s, src1)&0x3F;
-
-	if(shift > 39)
-		shift = 40;
-
-	writeLong(s, dst, (aux << shift));
-	dprintf("Result: %d\n",  (aux << shift));
+	shift_op<SHIFT_LEFT, 0, 1>(s, dst, src2, readReg(s, src1));
 }
 
 //!Instruction shl_ici behavior method.
 void ac_behavior( shl_ici ){
-	unsigned shift;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
-	shift = src1&0x3F;
-
-	if(shift > 39)
-		shift = 40;
-
-	writeReg(s, dst, (xsrc2 << shift));
-	dprintf("Result: %d\n",  (xsrc2 << shift));
 
+	shift_op<SHIFT_LEFT, 0, 0>(s, dst, src2, src1);
 }
 
 //!Instruction shl_lcl behavior method.
 void ac_behavior( shl_lcl ){
-	unsigned shift;
-	long long aux;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
-	aux = readLong(s, src2);
-	shift = src1&0x3F;
-
-	if(shift > 39)
-		shift = 40;
-
-	writeLong(s, dst, (aux << shift));
-	dprintf("Result: %d\n",  (aux << shift));
+	shift_op<SHIFT_LEFT, 1, 1>(s, dst, src2, src1);
 }
 
 //!Instruction shl_icl behavior method.
 void ac_behavior( shl_icl ){
-	unsigned shift;
-	long long aux;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
-	aux = (long long)xsrc2;
-	shift = src1&0x3F;
-
-	if(shift > 39)
-		shift = 40;
-
-	writeLong(s, dst, (aux << shift));
-	dprintf("Result: %d\n",  (aux << shift));
+	shift_op<SHIFT_LEFT, 0, 1>(s, dst, src2, src1);
 }
 
 //!Instruction shr_iii behavior method.
 void ac_behavior( shr_iii ){
-	unsigned shift;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
-	shift = readReg(s, src1)&0x3F;
-
-	if(shift > 39)
-		shift = 40;
-
-	writeReg(s, dst, ((int)xsrc2 >> shift));
-	dprintf("Result: %d\n",  ((int)xsrc2 >> shift));
 
+	shift_op<SHIFT_RIGHT, 0, 0>(s, dst, src2, readReg(s, src1));
 }
 
 //!Instruction shr_lil behavior method.
 void ac_behavior( shr_lil ){
-	unsigned shift;
-	long long aux;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
-	aux = readLong(s, src2);
-	shift = readReg(s, src1)&0x3F;
-
-	if(shift > 39)
-		shift = 40;
-
-	writeLong(s, dst, (aux >> shift));
-	dprintf("Result: %d\n",  (aux >> shift));
+	shift_op<SHIFT_RIGHT, 1, 1>(s, dst, src2, readReg(s, src1));
 }
 
 //!Instruction shr_ici behavior method.
 void ac_behavior( shr_ici ){
-	unsigned shift;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
-	shift = src1&0x3F;
-
-	if(shift > 39)
-		shift = 40;
-
-	writeReg(s, dst, (xsrc2 << shift));
-	dprintf("Result: %d\n",  (xsrc2 << shift));
 
+	shift_op<SHIFT_RIGHT, 0, 0>(s, dst, src2, src1);
 }
 
 //!Instruction shr_lcl behavior method.
 void ac_behavior( shr_lcl ){
-	unsigned shift;
-	long long aux;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
-	aux = readLong(s, src2);
-	shift = src1&0x3F;
-
-	if(shift > 39)
-		shift = 40;
-
-	writeLong(s, dst, (aux >> shift));
-	dprintf("Result: %d\n",  (aux >> shift));
+	shift_op<SHIFT_RIGHT, 1, 1>(s, dst, src2, src1);
 }
 
 //!Instruction shru_iii behavior method.
 void ac_behavior( shru_iii ){
-	unsigned shift;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
-	shift = readReg(s, src1)&0x3F;
-
-	if(shift > 39)
-		shift = 40;
-
-	writeReg(s, dst, ((unsigned)xsrc2 >> shift));
-	dprintf("Result: %d\n",  ((unsigned)xsrc2 >> shift));
 
+	shift_op<SHIFT_RIGHTU, 0, 0>(s, dst, src2, readReg(s, src1));
 }
 
 //!Instruction shru_lil behavior method.
 void ac_behavior( shru_lil ){
-	unsigned shift;
-	unsigned long long aux;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
-	aux = readLong(s, src2);
-	shift = readReg(s, src1)&0x3F;
-
-	if(shift > 39)
-		shift = 40;
-
-	writeLong(s, dst, (aux >> shift));
-	dprintf("Result: %d\n",  (aux >> shift));
+	shift_op<SHIFT_RIGHTU, 1, 1>(s, dst, src2, readReg(s, src1));
 }
 
 //!Instruction shru_ici behavior method.
 void ac_behavior( shru_ici ){
-	unsigned shift;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
-	shift = src1&0x3F;
-
-	if(shift > 39)
-		shift = 40;
-
-	writeReg(s, dst, ((unsigned)xsrc2 >> shift));
-	dprintf("Result: %d\n",  ((unsigned)xsrc2 >> shift));
 
+	shift_op<SHIFT_RIGHTU, 0, 0>(s, dst, src2, src1);
 }
 
 //!Instruction shru_lcl behavior method.
 void ac_behavior( shru_lcl ){
-	unsigned shift;
-	unsigned long long aux;
 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src2, src1, dst);
 
-	aux = (unsigned long long) readLong(s, src2);
-	shift = src1&0x3F;
-
-	if(shift > 39)
-		shift = 40;
-
-	writeLong(s, dst, (aux >> shift));
-	dprintf("Result: %d\n",  (aux >> shift));
+	shift_op<SHIFT_RIGHTU, 1, 1>(s, dst, src2, src1);
 }
 
 //!Instruction sub_s_iii behavior method.
 void ac_behavior( sub_s_iii ){ 
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
-	writeReg(s, dst, ((int)readReg(s, src1) - (int)xsrc2));
+	writeReg(s, dst, ((int)readReg(s, src1) - (int)ctx->xsrc2));
 }
 
 //!Instruction sub_s_cii behavior method.
@@ -2576,7 +3575,7 @@ void ac_behavior( sub_s_cii ){
 	cst = src1;
   dprintf("%s %d, r%d, r%d\n", get_name(), src2,(int)cst, dst);
 
-	writeReg(s, dst, (int)cst -(int)xsrc2);
+	writeReg(s, dst, (int)cst -(int)ctx->xsrc2);
 
 }
 
@@ -2587,9 +3586,9 @@ void ac_behavior( sub2 ){
   dprintf("%s r%d, r%d, r%d\n", get_name(), src1, src2, dst);
 
 	lsbsrc1 = 0xFFFF & ((int)readReg(s, src1));
-	lsbsrc2 = 0xFFFF & ((int)xsrc2);
+	lsbsrc2 = 0xFFFF & ((int)ctx->xsrc2);
 	msbsrc1 = ((int)readReg(s, src1)) >> 16;
-	msbsrc2 = ((int)xsrc2) >> 16;
+	msbsrc2 = ((int)ctx->xsrc2) >> 16;
 
 	writeReg(s, dst, ((msbsrc1-msbsrc2) <<16) | ((lsbsrc1-lsbsrc2)&0xFFFF));
 	dprintf("Result: %d\n", ((msbsrc1-msbsrc2) <<16) | ((lsbsrc1-lsbsrc2)&0xFFFF));
@@ -2599,45 +3598,37 @@ void ac_behavior( sub2 ){
 //!Instruction ext_k behavior method.
 void ac_behavior( ext_k ){ 
 
-  dprintf("%s r%d, %d, %d, r%d\n", get_name(), src2, csta, cstb, dst);
 	int src2a;
 
-	src2a = xsrc2;
+  dprintf("%s r%d, %d, %d, r%d\n", get_name(), src2, csta, cstb, dst);
 
-	src2a <<= csta;
-	src2a = (int)src2a >> cstb; 
+	src2a = (int)((unsigned int)readReg(s, src2) << csta) >> cstb;
 
-	writeReg(s, dst, (int)src2a);
-	dprintf("Result: %d\n", (int)src2a);
+	writeReg(s, dst, src2a);
+	dprintf("Result: %d\n", src2a);
 }
 
 //!Instruction extu_k behavior method.
 void ac_behavior( extu_k ){ 
 
 	unsigned int src;
-  dprintf("%s r%d, %d, %d, r%d\n", get_name(), src2, csta, cstb, dst);
 
-	src = readReg(s, src2);
+  dprintf("%s r%d, %d, %d, r%d\n", get_name(), src2, csta, cstb, dst);
 
-	src <<= csta;
-	(int)src >>= cstb; 
+	src = ((unsigned int)readReg(s, src2) << csta) >> cstb;
 
 	writeReg(s, dst, (int)src);
 	dprintf("Result: %d\n", (int)src);
-
 }
 
 //!Instruction clr_k behavior method.
 void ac_behavior( clr_k ){
 
-	int i;
-	sc_uint<32> src;
+	unsigned int src;
 
   dprintf("%s r%d, %d, %d, r%d\n", get_name(), src2, csta, cstb, dst);
-	src = readReg(s, src2);
 
-	for( i = csta; i<= (int)cstb; i++)
-		src[i] = 0;
+	src = readReg(s, src2) & ~field_mask(csta, cstb);
 
 	writeReg(s, dst, (int)src);
 	dprintf("Result: %d\n", (int)src);
@@ -2646,14 +3637,11 @@ void ac_behavior( clr_k ){
 //!Instruction set_k behavior method.
 void ac_behavior( set_k ){
 
-	int i;
-	sc_uint<32> src;
+	unsigned int src;
 
   dprintf("%s r%d, %d, %d, r%d\n", get_name(), src2, csta, cstb, dst);
-	src = readReg(s, src2);
 
-	for( i = csta; i<= (int)cstb; i++)
-		src[i] = 1;
+	src = readReg(s, src2) | field_mask(csta, cstb);
 
 	writeReg(s, dst, (int)src);
 	dprintf("Result: %d\n", (int)src);
@@ -2696,13 +3684,10 @@ void ac_behavior( b_lab ){
 
   dprintf("%s %d\n", get_name(), cst_b);
 
-	//TODO: Conferir com cuidado PCE1
-	target = (cst_b<<2) + RB_C.read(PCE1);
+	//The displacement is relative to the fetch packet of the branch
+	target = (cst_b<<2) + ctx->RB_C[PCE1];
 
-	//TODO: Isso soh funcionara direito se existir um controle sobre o paralelismo,
-	//      isto e, instrucoes q seriam executadas em paralelo ocupam o mesmo delay slot.
-	//      Ver exemplo no manual do TMSC6000 pagina 3-41.
-	ac_pc = delay(target, 5);
+	branch_to(target);
 
 	dprintf("Result: %d\n",target  );
 }
@@ -2712,10 +3697,7 @@ void ac_behavior( b_reg ){
 
   dprintf("%s %d\n", get_name(), src2);
 
-	//TODO: Isso soh funcionara direito se existir um controle sobre o paralelismo,
-	//      isto e, instrucoes q seriam executadas em paralelo ocupam o mesmo delay slot.
-	//      Ver exemplo no manual do TMSC6000 pagina 3-41.
-	ac_pc = delay(readReg(s, src2), 5);
+	branch_to(readReg(s, src2));
 
 	dprintf("Result: %d\n", readReg(s, src2)  );
 }
@@ -2726,15 +3708,14 @@ void ac_behavior( b_irp ){
 
   dprintf("%s %d\n", get_name(), src2);
 
-	//TODO: Isso soh funcionara direito se existir um controle sobre o paralelismo,
-	//      isto e, instrucoes q seriam executadas em paralelo ocupam o mesmo delay slot.
-	//      Ver exemplo no manual do TMSC6000 pagina 3-41.
-	ac_pc = delay(RB_C.read(IRP), 5);
+	branch_to(ctx->RB_C[IRP]);
 
-	//TODO: Copy PGIE to GIE if an interrupt control system should be added in the future.
-	//      See TMSC6000 ISA manual page 3-44.
+	//Returning from a maskable interrupt: GIE is restored from PGIE.
+	//See TMSC6000 ISA manual page 3-44.
+	ctx->RB_C[CSR] = (ctx->RB_C[CSR] & ~CSR_GIE) | ((ctx->RB_C[CSR] & CSR_PGIE) >> 1);
+	int_update(ctx);
 
-	dprintf("Result: %d\n", RB_C.read(IRP));
+	dprintf("Result: %d\n", ctx->RB_C[IRP]);
 }
 
 
@@ -2743,129 +3724,171 @@ void ac_behavior( b_nrp ){
 
   dprintf("%s %d\n", get_name(), src2);
 
-	//TODO: Isso soh funcionara direito se existir um controle sobre o paralelismo,
-	//      isto e, instrucoes q seriam executadas em paralelo ocupam o mesmo delay slot.
-	//      Ver exemplo no manual do TMSC6000 pagina 3-41.
-	ac_pc = delay( RB_C.read(NRP), 5);
+	branch_to(ctx->RB_C[NRP]);
 
-	//TODO: Set NMIE if an interrupt control system should be added in the future.
-	//      See TMSC6000 ISA manual page 3-46.
+	//Returning from a NMI: NMIE is set again. See TMSC6000 ISA manual page 3-46.
+	ctx->RB_C[IER] |= INT_NMI;
+	int_update(ctx);
 
-	dprintf("Result: %d\n", RB_C.read(NRP));
+	dprintf("Result: %d\n", ctx->RB_C[NRP]);
 
 }
 
 //!Instruction idle behavior method.
 void ac_behavior( idle ){ 
-	dprintf("IDLE does nothing.");
+	dprintf("IDLE until an interrupt.\n");
+
+	//The core sleeps from the next execute packet on, see ctx_run()
+	ctx->idle = 1;
 }
 
 //!Instruction nop behavior method.
 void ac_behavior( nop ){ 
 
-	//TODO:Is it necessary to have a multi-cycle NOP in this functional model?
-  dprintf("%s %d\n", get_name(), src);
+	int extra = src;  //Cycles beyond the first one
+
+  dprintf("%s %d\n", get_name(), src+1);
+
+	//NOP n takes n cycles, filling n delay slots of the pending branches. The
+	//oldest branch, when taken, ends the NOP.
+	if( ctx->br_count ){
+		int left = ctx->br[ctx->br_head].due - ctx->ep_seq - 1;
+
+		if( extra > left )
+			extra = left;
+	}
+	ctx->ep_seq += extra;
+
+	ctx->cycle_count += extra;
+	if( detailed )
+		ctx->stats.cycles += extra;
 
 }
 
 //!Instruction ldb behavior method.
-void ac_behavior( ldb ){ 
+void ac_behavior( ldb ){
+
+	int data;
 
   dprintf("%s *+r%d [%d], r%d \tmode: %x\n", get_name(), baseR, offsetR, dst, mode);
 
-	writeReg(s, dst, (int)MEM.read_byte(address));
-	dprintf("Result: %d\n", (int)MEM.read_byte(address));
+	data = (signed char)mem_read_byte(ctx->address);
+	writeReg(s, dst, data);
+	dprintf("Result: %d\n", data);
 }
 
 //!Instruction ldbu behavior method.
 void ac_behavior( ldbu ){
 
+	unsigned int data;
+
   dprintf("%s *+r%d [%d], r%d \tmode: %x\n", get_name(), baseR, offsetR, dst, mode);
 
-	writeReg(s, dst, (unsigned int)MEM.read_byte(address));
-	dprintf("Result: %d\n", (unsigned int)MEM.read_byte(address));
+	data = mem_read_byte(ctx->address);
+	writeReg(s, dst, data);
+	dprintf("Result: %d\n", data);
 }
 
 //!Instruction ldh behavior method.
 void ac_behavior( ldh ){
 
+	int data;
+
   dprintf("%s *+r%d [%d], r%d \tmode: %x\n", get_name(), baseR, offsetR, dst, mode);
 
-	writeReg(s, dst, (int)MEM.read_half(address));
-	dprintf("Result: %d\n", (int)MEM.read_half(address));
+	data = (short)mem_read_half(ctx->address);
+	writeReg(s, dst, data);
+	dprintf("Result: %d\n", data);
 }
 
 //!Instruction ldhu behavior method.
-void ac_behavior( ldhu ){ 
+void ac_behavior( ldhu ){
+
+	unsigned int data;
 
   dprintf("%s *+r%d [%d], r%d \tmode: %x\n", get_name(), baseR, offsetR, dst, mode);
 
-	writeReg(s, dst, (unsigned int)MEM.read_half(address));
-	dprintf("Result: %d\n", (unsigned int)MEM.read_half(address));
+	data = mem_read_half(ctx->address);
+	writeReg(s, dst, data);
+	dprintf("Result: %d\n", data);
 }
 
 
 //!Instruction ldw behavior method.
 void ac_behavior( ldw ){
 
+	int data;
+
   dprintf("%s *+r%d [%d], r%d \tmode: %x\n", get_name(), baseR, offsetR, dst, mode);
 
-	writeReg(s, dst, (int)MEM.read(address));
-	dprintf("Result: %d\n", (int)MEM.read(address));
+	data = mem_read(ctx->address);
+	writeReg(s, dst, data);
+	dprintf("Result: %d\n", data);
 }
 
 //!Instruction ldb_k behavior method.
-void ac_behavior( ldb_k ){ 
+void ac_behavior( ldb_k ){
+
+	int data;
 
   dprintf("%s *+r%d [%d], r%d\n", get_name(), y+14, ucst, dst);
 
-	writeReg(s, dst, (int)MEM.read_byte(address + ucst));
-	dprintf("Result: %d\n", (int)MEM.read_byte(address + ucst));
+	//The constant was scaled by D_LDST_K
+	data = (signed char)mem_read_byte(ctx->address);
+	writeReg(s, dst, data);
+	dprintf("Result: %d\n", data);
 }
 
 //!Instruction ldbu_k behavior method.
 void ac_behavior( ldbu_k ){
 
+	unsigned int data;
+
   dprintf("%s *+r%d [%d], r%d\n", get_name(), y+14, ucst, dst);
 
-	writeReg(s, dst, (unsigned int)MEM.read_byte(address + ucst));
-	dprintf("Result: %d\n", (unsigned int)MEM.read_byte(address + ucst));
+	//The constant was scaled by D_LDST_K
+	data = mem_read_byte(ctx->address);
+	writeReg(s, dst, data);
+	dprintf("Result: %d\n", data);
 }
 
 //!Instruction ldh_k behavior method.
 void ac_behavior( ldh_k ){
 
-  dprintf("%s *+r%d [%d], r%d\n", get_name(), y+14, ucst, dst);
+	int data;
 
-	//scaling offset
-	ucst <<= 1;
+  dprintf("%s *+r%d [%d], r%d\n", get_name(), y+14, ucst, dst);
 
-	writeReg(s, dst, (int)MEM.read_half(address + ucst));
-	dprintf("Result: %d\n", (int)MEM.read_half(address + ucst));
+	//The constant was scaled by D_LDST_K
+	data = (short)mem_read_half(ctx->address);
+	writeReg(s, dst, data);
+	dprintf("Result: %d\n", data);
 }
 
 //!Instruction ldhu_k behavior method.
 void ac_behavior( ldhu_k ){
 
-  dprintf("%s *+r%d [%d], r%d\n", get_name(), y+14, ucst, dst);
+	unsigned int data;
 
-	//scaling offset
-	ucst <<= 1;
+  dprintf("%s *+r%d [%d], r%d\n", get_name(), y+14, ucst, dst);
 
-	writeReg(s, dst, (unsigned int)MEM.read_half(address + ucst));
-	dprintf("Result: %d\n", (unsigned int)MEM.read_half(address + ucst));
+	//The constant was scaled by D_LDST_K
+	data = mem_read_half(ctx->address);
+	writeReg(s, dst, data);
+	dprintf("Result: %d\n", data);
 }
 
 //!Instruction ldw_k behavior method.
 void ac_behavior( ldw_k ){
 
-  dprintf("%s *+r%d [%d], r%d\n", get_name(), y+14, ucst, dst);
+	int data;
 
-	//scaling offset
-	ucst <<= 2;
+  dprintf("%s *+r%d [%d], r%d\n", get_name(), y+14, ucst, dst);
 
-	writeReg(s, dst, MEM.read(address + ucst));
-	dprintf("Result: %d\n", MEM.read(address + ucst));
+	//The constant was scaled by D_LDST_K
+	data = mem_read(ctx->address);
+	writeReg(s, dst, data);
+	dprintf("Result: %d\n", data);
 }
 
 //!Instruction stb behavior method.
@@ -2878,7 +3901,7 @@ void ac_behavior( stb ){
 	//Getting the data to be stored.
 	src = readReg(s, dst) & 0xFF;
 
-	MEM.write_byte(address, src);
+	mem_write_byte(ctx->address, src);
 	dprintf("Result: %d\n", src);
 }
 
@@ -2892,7 +3915,7 @@ void ac_behavior( sth ){
 	//Getting the data to be stored.
 	src = readReg(s, dst) & 0xFFFF;
 
-	MEM.write_half(address, src);
+	mem_write_half(ctx->address, src);
 	dprintf("Result: %d\n", src);
 }
 
@@ -2906,7 +3929,7 @@ void ac_behavior( stw ){
 	//Getting the data to be stored.
 	src = readReg(s, dst);
 
-	MEM.write(address, src);
+	mem_write(ctx->address, src);
 	dprintf("Result: %d\n", src);
 }
 
@@ -2916,42 +3939,191 @@ void ac_behavior( stb_k ){
  
 	dprintf("%s r%d, *+r%d [%d]\n", get_name(), dst, y+14, ucst);
 
-	//Getting the data to be stored.
+	//Getting the data to be stored. The constant was scaled by D_LDST_K.
 	src = readReg(s, dst) & 0xFF;
 
-	MEM.write_byte(address+ucst, src);
+	mem_write_byte(ctx->address, src);
 	dprintf("Result: %d\n", src);
 }
 
 //!Instruction sth_k behavior method.
-void ac_behavior( sth_k ){ 
+void ac_behavior( sth_k ){
 	short src=0;
  
 	dprintf("%s r%d, *+r%d [%d]\n", get_name(), dst, y+14, ucst);
 
-	//scaling offset
-	ucst <<= 1;
-
-	//Getting the data to be stored.
+	//Getting the data to be stored. The constant was scaled by D_LDST_K.
 	src = readReg(s, dst) & 0xFFFF;
 
-	MEM.write_half(address+ucst, src);
+	mem_write_half(ctx->address, src);
 	dprintf("Result: %d\n", src);
 }
 
 //!Instruction stw_k behavior method.
 void ac_behavior( stw_k ){
- 	int src=0;
-
+	int src=0;
+ 
 	dprintf("%s r%d, *+r%d [%d]\n", get_name(), dst, y+14, ucst);
 
-	//scaling offset
-	ucst <<= 2;
-
-	//Getting the data to be stored.
+	//Getting the data to be stored. The constant was scaled by D_LDST_K.
 	src = readReg(s, dst);
 
-	MEM.write(address+ucst, src);
+	mem_write(ctx->address, src);
 	dprintf("Result: %d\n", src);
 }
 
+};
+
+#pragma pop_macro("ac_behavior")
+
+/* The format and instruction behaviors of every instruction, indexed by DEC_* */
+struct insn_entry {
+	void (tms62x_insn::*format)();
+	void (tms62x_insn::*behavior)();
+};
+
+#define INSN_ENTRY(i, f) { &tms62x_insn::f, &tms62x_insn::i },
+static const insn_entry insn_table[DEC_INSTRS] = { DEC_INSTR_LIST(INSN_ENTRY) };
+#undef INSN_ENTRY
+
+/* Runs the core of the current context from ctx->pc until a stop condition
+   armed by the library interface or the end of the program. Returns
+   TMS62X_CYCLES or TMS62X_PC when it stopped before an instruction,
+   TMS62X_DONE when the program ended and TMS62X_ERROR on an instruction
+   that could not be fetched or decoded. */
+int ctx_run(){
+
+	tms62x_insn in;
+
+	for(;;){
+		unsigned int pc = ctx->pc;
+		int slot = (pc >> 2) & 7;
+
+		//Stop conditions requested through the library interface. They are
+		//tested first, so that a run resumes without repeating any step.
+		if( ctx->stop_armed ){
+			if( ctx->stop_cycle >= 0 && ctx->cycle_count >= ctx->stop_cycle )
+				return TMS62X_CYCLES;
+			if( (long long)pc == ctx->stop_pc )
+				return TMS62X_PC;
+		}
+
+		//Fetching a new fetch packet when the pc leaves the current one
+		if( ((pc & ~31u) != ctx->fp_addr || !ctx->fp_valid) && !fetch_packet(pc & ~31u) )
+			return TMS62X_ERROR;
+
+		//Peripheral events that are due
+		if( ctx->cycle_count >= ctx->evq.next )
+			evq_run();
+
+		//A redirected pc starts an execute packet wherever it lands in the
+		//fetch packet, whatever the p-bits before it
+		if( (ctx->fp->ep >> slot & 1) || ctx->ep_start ){
+			//An idle core stays before this packet until an enabled interrupt is
+			//pending. The peripheral events are what raise them, so it skips
+			//from one event to the next, stopping at the stop cycle. With no
+			//event left nothing can raise one, and the program ended.
+			if( ctx->idle ){
+				if( !(ctx->RB_C[IFR] & ctx->int_enable) ){
+					if( !ctx->evq.count )
+						return TMS62X_DONE;
+					evq_skip(ctx->stop_armed ? ctx->stop_cycle : -1);
+					continue;
+				}
+				ctx->idle = 0;
+			}
+
+			//The oldest branch is taken at the start of the execute packet that
+			//follows its delay slots. The target starts the packet again.
+			if( ctx->br_count && ctx->br[ctx->br_head].due == ctx->ep_seq + 1 ){
+				ctx->pc = ctx->br[ctx->br_head].target;
+				ctx->br_head = (ctx->br_head + 1) & (TMS62X_BRANCHES - 1);
+				ctx->br_count--;
+				ctx->ep_start = 1;
+				continue;
+			}
+
+			//Interrupts are taken between execute packets, but not in branch
+			//delay slots. The vector starts the packet again, which is counted
+			//there.
+			if( (ctx->RB_C[IFR] & ctx->int_enable) && !ctx->br_count ){
+				int_take(ctx->RB_C[IFR] & ctx->int_enable);
+				ctx->ep_start = 1;
+				continue;
+			}
+			ctx->ep_seq++;
+			ctx->ep_start = 0;
+
+			//No memory bank is busy at the start of an execute packet
+			ctx->ep_pc = pc;
+			ctx->ep_banks = 0;
+		}
+
+		//Sampled simulation: start or finish a detailed interval
+		if( sample_interval ){
+			if( ctx->insn_count == sample_end )
+				sample_finish();
+			else if( sample_end < 0 && sample_here() )
+				sample_fork();
+		}
+
+		if( !triggers.empty() )
+			check_triggers(pc);
+
+		if( bbv_interval )
+			bbv_step(pc);
+
+		ctx->insn_count++;
+
+		in.decoded = &ctx->fp->slot[slot];
+		in.id = in.decoded->id;
+		if( in.id < 0 ){
+			cerr << "Invalid instruction: " << hex << in.decoded->word << " at pc: " << pc << dec << endl;
+			return TMS62X_ERROR;
+		}
+
+		ctx->pc = pc + 4;
+		in.annulled = 0;
+		dec_extractors[dec_instrs[in.id].format](in, in.decoded->word);
+
+		in.instruction();
+		if( !in.annulled ){
+			(in.*insn_table[in.id].format)();
+			(in.*insn_table[in.id].behavior)();
+		}
+	}
+}
+
+/*--------------------------------------------------------------------------------*/
+
+/* Behaviors of the acsim-generated simulator. The stand-alone simulator only
+   runs the generic one, at the first instruction: it moves the state left by
+   the ArchC loader into the main context, runs the whole program with
+   ctx_run() and stops. */
+
+//!Generic instruction behavior method.
+void ac_behavior( instruction ){
+
+	if( !ctx_init(&main_ctx) ){
+		cerr << "Could not allocate the memory image." << endl;
+		exit(1);
+	}
+	ctx_load_regs(&main_ctx);
+	atexit(ctx_exit);
+	model_init(true);
+
+	main_ctx.pc = ac_pc;
+	ctx_run();
+
+	ac_pc = main_ctx.pc;
+	ac_annul();
+	ac_stop();
+}
+
+//The format and instruction behaviors are never reached
+#define ARCHC_FORMAT(f) void ac_behavior( f ){}
+#define ARCHC_INSTR(i, f) void ac_behavior( i ){}
+DEC_FORMAT_LIST(ARCHC_FORMAT)
+DEC_INSTR_LIST(ARCHC_INSTR)
+#undef ARCHC_FORMAT
+#undef ARCHC_INSTR
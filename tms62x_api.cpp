@@ -0,0 +1,374 @@
+/**
+ * @file      tms62x_api.cpp
+ * @author    Sandro Rigo
+ *
+ *            The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br
+ *
+ * @version   1.0
+ *
+ * @brief     C interface of the TMS320C62x model library.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+#include  "tms62x_ctx.H"
+#include  "tms62x_shared.H"
+#include  "tms62x_cache.H"
+#include  "tms62x_map.H"
+#include  "tms62x_api.h"
+#include  <pthread.h>
+#include  <string.h>
+#include  <stdlib.h>
+
+//The loaded program (ctx.prog) holds the image restored by tms62x_reset()
+struct tms62x_sim {
+	tms62x_ctx ctx;
+};
+
+//The model configuration, read by the first tms62x_create()
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+
+static void lib_init(void){
+
+	model_init(false);
+}
+
+tms62x_sim *tms62x_create(void){
+
+	tms62x_sim *sim;
+
+	pthread_once(&init_once, lib_init);
+
+	if( !(sim = (tms62x_sim *)calloc(1, sizeof(tms62x_sim))) )
+		return 0;
+
+	if( !ctx_init(&sim->ctx) ){
+		free(sim);
+		return 0;
+	}
+
+	return sim;
+}
+
+void tms62x_destroy(tms62x_sim *sim){
+
+	if( !sim )
+		return;
+
+	ctx_free(&sim->ctx);
+	free(sim);
+}
+
+/* Copies size bytes between the memory of a context, out of the shared
+   region, and buf, a page at a time beyond the memory image. A write checks
+   that every byte is backed by storage before it changes any of them.
+   Returns 0 on success. */
+static int mem_copy(tms62x_ctx *c, unsigned int addr, unsigned char *buf, unsigned int size, int write){
+
+	if( addr + size < addr )
+		return -1;
+
+	for( int pass = !write; pass < 2; pass++ ){
+		unsigned int a = addr, left = size;
+		unsigned char *b = buf;
+
+		while( left ){
+			unsigned int n = a < c->mem_size ? c->mem_size - a : MAP_PAGE_SIZE - (a & (MAP_PAGE_SIZE - 1));
+			unsigned char *m;
+
+			if( n > left )
+				n = left;
+			if( !(m = mem_host(c, a, n)) )
+				return -1;
+
+			if( pass && write )
+				memcpy(m, b, n);
+			else if( pass )
+				memcpy(b, m, n);
+			a += n;
+			b += n;
+			left -= n;
+		}
+	}
+
+	return 0;
+}
+
+void tms62x_reset(tms62x_sim *sim){
+
+	unsigned char *mem = sim->ctx.mem;
+	unsigned int size = sim->ctx.mem_size;
+	tms62x_map *map = sim->ctx.map;
+	tms62x_shared *sh = sim->ctx.shared;
+	tms62x_cache *cache = sim->ctx.cache;
+	tms62x_prog *prog = sim->ctx.prog;
+	int core = sim->ctx.core_id;
+
+	ext_free(&sim->ctx);
+	memset(&sim->ctx, 0, sizeof(sim->ctx));
+	sim->ctx.mem = mem;
+	sim->ctx.mem_size = size;
+	sim->ctx.map = map;
+	sim->ctx.shared = sh;
+	sim->ctx.core_id = core;
+	sim->ctx.cache = cache;
+	sim->ctx.prog = prog;
+	if( cache )
+		cache_invalidate(cache);
+	sim->ctx.stop_cycle = -1;
+	sim->ctx.stop_pc = -1;
+
+	memset(mem, 0, size);
+	if( prog ){
+		mem_copy(&sim->ctx, prog->addr, prog->image, prog->size, 1);
+		sim->ctx.pc = prog->addr;
+	}
+	sim->ctx.ep_start = 1;
+}
+
+int tms62x_copy_state(tms62x_sim *dst, const tms62x_sim *src){
+
+	unsigned char *mem = dst->ctx.mem;
+	unsigned char ***ext;
+	tms62x_shared *sh = dst->ctx.shared;
+	tms62x_cache *cache = dst->ctx.cache;
+	int core = dst->ctx.core_id;
+	int ok = ext_copy(&dst->ctx, &src->ctx);
+
+	ext = dst->ctx.ext;
+	if( src->ctx.map )
+		__sync_add_and_fetch(&src->ctx.map->refs, 1);
+	map_release(dst->ctx.map);
+	prog_retain(src->ctx.prog);
+	prog_release(dst->ctx.prog);
+	memcpy(mem, src->ctx.mem, src->ctx.mem_size);
+	dst->ctx = src->ctx;
+	dst->ctx.mem = mem;
+	dst->ctx.ext = ext;
+	dst->ctx.shared = sh;
+	dst->ctx.core_id = core;
+	dst->ctx.cache = cache;
+	if( cache && src->ctx.cache )
+		cache_copy(cache, src->ctx.cache);
+
+	//A fetch packet decoded by src itself is now in the copy of its context
+	if( src->ctx.fp == &src->ctx.fp_own )
+		dst->ctx.fp = &dst->ctx.fp_own;
+
+	return ok ? 0 : -1;
+}
+
+int tms62x_load(tms62x_sim *sim, const void *image, unsigned int size, unsigned int addr){
+
+	tms62x_prog *prog;
+
+	if( !(prog = prog_acquire((const unsigned char *)image, size, addr)) )
+		return -1;
+
+	if( mem_copy(&sim->ctx, addr, prog->image, size, 1) ){
+		prog_release(prog);
+		return -1;
+	}
+
+	prog_release(sim->ctx.prog);
+	sim->ctx.prog = prog;
+
+	sim->ctx.pc = addr;
+	sim->ctx.ep_start = 1;
+	sim->ctx.fp_valid = 0;
+
+	return 0;
+}
+
+int tms62x_load_map(tms62x_sim *sim, const char *file){
+
+	tms62x_map *map = 0;
+
+	if( file && !(map = map_load(file)) )
+		return -1;
+
+	ext_free(&sim->ctx);
+	map_release(sim->ctx.map);
+	sim->ctx.map = map;
+	memset(sim->ctx.open_row, 0, sizeof(sim->ctx.open_row));
+	sim->ctx.ep_region = 0;
+	sim->ctx.ep_banks = 0;
+	sim->ctx.fp_valid = 0;
+	if( sim->ctx.prog )
+		mem_copy(&sim->ctx, sim->ctx.prog->addr, sim->ctx.prog->image, sim->ctx.prog->size, 1);
+
+	return 0;
+}
+
+unsigned int tms62x_get_pc(tms62x_sim *sim){
+
+	return sim->ctx.pc;
+}
+
+void tms62x_set_pc(tms62x_sim *sim, unsigned int pc){
+
+	sim->ctx.pc = pc;
+	sim->ctx.ep_start = 1;
+}
+
+/* Returns the register file selected by file, or NULL */
+static int *reg_file(tms62x_sim *sim, int file, int reg){
+
+	switch( file ){
+	case TMS62X_RB_A:
+	case TMS62X_RB_B:
+		return reg >= 0 && reg < 16 ? &sim->ctx.R[(file<<4)|reg] : 0;
+	case TMS62X_RB_C:
+		ctx_fold_sat(&sim->ctx);
+		return reg >= 0 && reg < 20 ? &sim->ctx.RB_C[reg] : 0;
+	default:
+		return 0;
+	}
+}
+
+unsigned int tms62x_get_reg(tms62x_sim *sim, int file, int reg){
+
+	int *r = reg_file(sim, file, reg);
+
+	return r ? *r : 0;
+}
+
+void tms62x_set_reg(tms62x_sim *sim, int file, int reg, unsigned int value){
+
+	int *r = reg_file(sim, file, reg);
+
+	if( r )
+		*r = value;
+
+	//AMR is control register 0; CSR and IER hold the interrupt enables
+	if( r && file == TMS62X_RB_C && reg == 0 )
+		amr_decode(&sim->ctx);
+	if( r && file == TMS62X_RB_C )
+		int_update(&sim->ctx);
+}
+
+/* Copies size bytes between the memory of an instance and buf, in the shared
+   region if the instance is attached to one that holds addr. Returns 0 on
+   success, -1 if out of bounds. */
+static int mem_access(tms62x_sim *sim, unsigned int addr, unsigned char *buf, unsigned int size, int write){
+
+	tms62x_shared *sh = sim->ctx.shared;
+
+	if( sh && addr - sh->base < sh->size ){
+		unsigned char *m = sh->data + (addr - sh->base);
+
+		if( addr + size < addr || addr - sh->base + size > sh->size )
+			return -1;
+		if( write )
+			memcpy(m, buf, size);
+		else
+			memcpy(buf, m, size);
+		return 0;
+	}
+
+	return mem_copy(&sim->ctx, addr, buf, size, write);
+}
+
+int tms62x_read_mem(tms62x_sim *sim, unsigned int addr, void *buf, unsigned int size){
+
+	return mem_access(sim, addr, (unsigned char *)buf, size, 0);
+}
+
+int tms62x_write_mem(tms62x_sim *sim, unsigned int addr, const void *buf, unsigned int size){
+
+	if( mem_access(sim, addr, (unsigned char *)buf, size, 1) )
+		return -1;
+
+	sim->ctx.fp_valid = 0;  //The program may have changed
+	return 0;
+}
+
+int tms62x_run(tms62x_sim *sim, long long cycles, long long until_pc){
+
+	int ret;
+	tms62x_ctx *c = &sim->ctx;
+
+	c->stop_cycle = cycles >= 0 ? c->cycle_count + cycles : -1;
+	c->stop_pc = until_pc;
+	c->stop_armed = cycles >= 0 || until_pc >= 0;
+
+	//The context pointer is per thread, so instances run in parallel
+	ctx = c;
+	ret = ctx_run();
+	ctx = &main_ctx;
+
+	c->stop_armed = 0;
+
+	return ret;
+}
+
+long long tms62x_get_cycles(tms62x_sim *sim){
+
+	return sim->ctx.cycle_count;
+}
+
+void tms62x_get_stats(tms62x_sim *sim, tms62x_stats *st){
+
+	st->instrs = sim->ctx.stats.instrs;
+	st->cycles = sim->ctx.stats.cycles;
+	for( int i = 0; i < 4; i++ )
+		st->unit[i] = sim->ctx.stats.unit[i];
+	st->loads = sim->ctx.stats.loads;
+	st->stores = sim->ctx.stats.stores;
+	st->stalls = sim->ctx.stats.stalls;
+	st->bank_stalls = sim->ctx.stats.bank_stalls;
+	for( int i = 0; i < 3; i++ ){
+		st->hits[i] = sim->ctx.stats.hits[i];
+		st->misses[i] = sim->ctx.stats.misses[i];
+	}
+}
+
+tms62x_shared *tms62x_shared_create(unsigned int base, unsigned int size, int latency, int penalty){
+
+	tms62x_shared *sh;
+
+	if( size <= IPC_SIZE || base + size < base )
+		return 0;
+
+	sh = new tms62x_shared;
+	sh->base = base;
+	sh->size = size;
+	sh->latency = latency;
+	sh->penalty = penalty;
+	sh->last_core = -1;
+	memset(sh->sem, 0, sizeof(sh->sem));
+
+	if( !(sh->data = (unsigned char *)calloc(size, 1)) ){
+		delete sh;
+		return 0;
+	}
+	pthread_mutex_init(&sh->lock, 0);
+
+	return sh;
+}
+
+void tms62x_shared_destroy(tms62x_shared *sh){
+
+	if( !sh )
+		return;
+
+	pthread_mutex_destroy(&sh->lock);
+	free(sh->data);
+	delete sh;
+}
+
+int tms62x_attach(tms62x_sim *sim, tms62x_shared *sh, int core){
+
+	if( core < 0 || core >= SHARED_MAX_CORES )
+		return -1;
+
+	sim->ctx.shared = sh;
+	sim->ctx.core_id = core;
+	return 0;
+}
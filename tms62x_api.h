@@ -0,0 +1,121 @@
+/**
+ * @file      tms62x_api.h
+ * @author    Sandro Rigo
+ *
+ *            The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br
+ *
+ * @version   1.0
+ *
+ * @brief     C interface of the TMS320C62x model library.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+#ifndef TMS62X_API_H
+#define TMS62X_API_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A simulator instance: registers, memory, program counter and statistics
+   of one C62x core. Each instance runs the program loaded in its own memory.
+   Different instances may run at the same time on different threads, but
+   one instance must only be used by one thread at a time. */
+typedef struct tms62x_sim tms62x_sim;
+
+typedef struct {
+	long long instrs;
+	long long cycles;
+	long long unit[4];  /* Instructions executed on the L, S, M and D units */
+	long long loads;
+	long long stores;
+	long long stalls;       /* Memory stall cycles (cache misses, wait states and
+	                           bank conflicts), included in cycles */
+	long long bank_stalls;  /* Bank conflict stall cycles, included in stalls */
+	long long hits[3];      /* Cache hits and misses of the L1P, L1D and L2 levels,
+	                           zero without caches */
+	long long misses[3];
+} tms62x_stats;
+
+/* Register files */
+enum { TMS62X_RB_A, TMS62X_RB_B, TMS62X_RB_C };
+
+/* Bytes of memory of an instance, as declared in tms62x.ac. Addresses above
+   it are only reached through the regions of a memory map. */
+#define TMS62X_MEM_SIZE (5 * 1024 * 1024)
+
+/* Reasons for tms62x_run() to return */
+enum { TMS62X_ERROR = -1, TMS62X_DONE, TMS62X_CYCLES, TMS62X_PC };
+
+/* Creates an instance with cleared registers and memory. Returns NULL on failure. */
+tms62x_sim *tms62x_create(void);
+
+void tms62x_destroy(tms62x_sim *sim);
+
+/* Clears registers, memory, caches, statistics and the cycle count. The program
+   loaded with tms62x_load() is copied back into the memory. */
+void tms62x_reset(tms62x_sim *sim);
+
+/* Copies the whole state of src (registers, memory and memory map, loaded
+   program, cache contents, pc, cycle count and statistics) into dst, which
+   keeps its own shared region attachment. Used to start many runs from one
+   checkpoint. Returns 0 on success. */
+int tms62x_copy_state(tms62x_sim *dst, const tms62x_sim *src);
+
+/* Loads a binary image at addr, both as program and as initial data, and sets
+   the program counter to addr. The program is decoded once and the decoding
+   shared by the instances that load the same image at the same address.
+   Returns 0 on success. */
+int tms62x_load(tms62x_sim *sim, const void *image, unsigned int size, unsigned int addr);
+
+/* Gives the instance the memory map read from file (see TMS62X_MEMMAP in the
+   README), or none if file is NULL, in place of the one of the environment.
+   The memory beyond the 5MB image is cleared, so it is set up before the
+   program runs. Returns 0 on success, -1 if the file is not valid. */
+int tms62x_load_map(tms62x_sim *sim, const char *file);
+
+unsigned int tms62x_get_pc(tms62x_sim *sim);
+void tms62x_set_pc(tms62x_sim *sim, unsigned int pc);
+
+unsigned int tms62x_get_reg(tms62x_sim *sim, int file, int reg);
+void tms62x_set_reg(tms62x_sim *sim, int file, int reg, unsigned int value);
+
+/* Copy size bytes between the instance memory and buf. Return 0 on success. */
+int tms62x_read_mem(tms62x_sim *sim, unsigned int addr, void *buf, unsigned int size);
+int tms62x_write_mem(tms62x_sim *sim, unsigned int addr, const void *buf, unsigned int size);
+
+/* Runs until the program ends, for at most cycles cycles (if cycles >= 0) or
+   until the program counter reaches until_pc (if until_pc >= 0). Another call
+   continues from where the previous one stopped. The program ends at an IDLE
+   that no peripheral event can wake; the core stays idle, so an interrupt
+   raised with tms62x_set_reg() before another call wakes it. */
+int tms62x_run(tms62x_sim *sim, long long cycles, long long until_pc);
+
+long long tms62x_get_cycles(tms62x_sim *sim);
+void tms62x_get_stats(tms62x_sim *sim, tms62x_stats *st);
+
+/* A memory region seen by several instances at [base, base+size). The first
+   0x200 bytes hold the inter-core semaphores and mailboxes (see
+   tms62x_shared.H). Every access costs latency cycles, plus penalty cycles
+   when the previous access came from another core. */
+typedef struct tms62x_shared tms62x_shared;
+
+tms62x_shared *tms62x_shared_create(unsigned int base, unsigned int size, int latency, int penalty);
+void tms62x_shared_destroy(tms62x_shared *sh);
+
+/* Attaches an instance to a shared region as core number core (0 to 7).
+   Returns 0 on success. */
+int tms62x_attach(tms62x_sim *sim, tms62x_shared *sh, int core);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
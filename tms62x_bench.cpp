@@ -0,0 +1,185 @@
+/**
+ * @file      tms62x_bench.cpp
+ * @author    Sandro Rigo
+ *
+ *            The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br
+ *
+ * @version   1.0
+ *
+ * @brief     Measures the simulation cost of single instructions.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Usage: tms62x_bench [iterations]
+//
+// Built with the library and run by "make -f Makefile.lib bench". Every
+// benchmark is a loop of 16 copies of one instruction, run for the given
+// number of iterations (default 200000) in the mode selected by TMS62X_MODE.
+// The time of the same loop without the copies is subtracted, so the report
+// is the host time of one simulated instruction, fetch, decode lookup and
+// execute packet bookkeeping included. Each loop runs 3 times and the fastest
+// run is kept.
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#include  "tms62x_api.h"
+#include  "tms62x_asm.H"
+#include  <stdio.h>
+#include  <stdlib.h>
+#include  <time.h>
+
+//Copies of the instruction in the loop body
+#define UNROLL 16
+
+//Register values: A5 and A6 are the operands, A6:A7 the 40-bit one, A2 the
+//predicate and A10 and B14 the base of the loads and stores
+#define REG_OPERAND1 0x00012345
+#define REG_OPERAND2 0x00000007
+#define REG_BASE     0x00001000
+
+#define END ((char *)0)
+
+struct bench {
+	const char *label;
+	unsigned int word;
+};
+
+//The instruction families that the behaviors implement with the kernels and
+//templates: plain and 40-bit arithmetic, saturation, compares, multiplies,
+//shifts, bit fields, address arithmetic, loads and stores and predication
+static const bench benches[] = {
+	{ "nop",           asm_insn("nop", END) },
+	{ "add .L",        asm_insn("add_l_iii", "dst", 4, "src1", 5, "src2", 6, END) },
+	{ "add .L long",   asm_insn("add_l_ill", "dst", 8, "src1", 5, "src2", 6, END) },
+	{ "add .S",        asm_insn("add_s_iii", "dst", 4, "src1", 5, "src2", 6, END) },
+	{ "add .D",        asm_insn("add_d_iii", "dst", 4, "src1", 5, "src2", 6, END) },
+	{ "sub .L",        asm_insn("sub_l_iii", "dst", 4, "src1", 5, "src2", 6, END) },
+	{ "sub .L long",   asm_insn("sub_l_cll", "dst", 8, "src1", 3, "src2", 6, END) },
+	{ "sadd",          asm_insn("sadd_iii", "dst", 4, "src1", 5, "src2", 6, END) },
+	{ "sadd long",     asm_insn("sadd_ill", "dst", 8, "src1", 5, "src2", 6, END) },
+	{ "ssub",          asm_insn("ssub_iii", "dst", 4, "src1", 5, "src2", 6, END) },
+	{ "sat",           asm_insn("sat", "dst", 4, "src2", 6, END) },
+	{ "abs long",      asm_insn("abs_ll", "dst", 8, "src2", 6, END) },
+	{ "cmpgt",         asm_insn("cmpgt_iii", "dst", 4, "src1", 5, "src2", 6, END) },
+	{ "cmpltu long",   asm_insn("cmpltu_ili", "dst", 4, "src1", 5, "src2", 6, END) },
+	{ "mpy",           asm_insn("mpy", "dst", 4, "src1", 5, "src2", 6, END) },
+	{ "mpyhu",         asm_insn("mpyhu", "dst", 4, "src1", 5, "src2", 6, END) },
+	{ "smpy",          asm_insn("smpy", "dst", 4, "src1", 5, "src2", 6, END) },
+	{ "shl",           asm_insn("shl_iii", "dst", 4, "src1", 6, "src2", 5, END) },
+	{ "shl long",      asm_insn("shl_lil", "dst", 8, "src1", 5, "src2", 6, END) },
+	{ "shr imm",       asm_insn("shr_ici", "dst", 4, "src1", 3, "src2", 5, END) },
+	{ "shru long",     asm_insn("shru_lcl", "dst", 8, "src1", 3, "src2", 6, END) },
+	{ "ext",           asm_insn("ext_k", "dst", 4, "src2", 5, "csta", 8, "cstb", 16, END) },
+	{ "extu",          asm_insn("extu", "dst", 4, "src1", 6, "src2", 5, END) },
+	{ "clr",           asm_insn("clr_k", "dst", 4, "src2", 5, "csta", 4, "cstb", 12, END) },
+	{ "lmbd",          asm_insn("lmbd_iii", "dst", 4, "src1", 6, "src2", 5, END) },
+	{ "norm",          asm_insn("norm_ii", "dst", 4, "src2", 5, END) },
+	{ "norm long",     asm_insn("norm_li", "dst", 4, "src2", 6, END) },
+	{ "addaw",         asm_insn("addaw_iii", "dst", 4, "src1", 6, "src2", 10, END) },
+	{ "addaw imm",     asm_insn("addaw_ici", "dst", 4, "src1", 3, "src2", 10, END) },
+	{ "ldw",           asm_insn("ldw", "dst", 4, "baseR", 10, "offsetR", 1, "mode", 1, END) },
+	{ "ldw modify",    asm_insn("ldw", "dst", 4, "baseR", 10, "offsetR", 0, "mode", 0xB, END) },
+	{ "ldw B14",       asm_insn("ldw_k", "dst", 4, "ucst", 2, "y", 0, END) },
+	{ "stw",           asm_insn("stw", "dst", 5, "baseR", 10, "offsetR", 1, "mode", 1, END) },
+	{ "ldh",           asm_insn("ldh", "dst", 4, "baseR", 10, "offsetR", 1, "mode", 1, END) },
+	{ "stb",           asm_insn("stb", "dst", 5, "baseR", 10, "offsetR", 1, "mode", 1, END) },
+	{ "[A2] add",      asm_insn("add_l_iii", "creg", 5, "z", 0, "dst", 4, "src1", 5, "src2", 6, END) },
+	{ "[!A2] add",     asm_insn("add_l_iii", "creg", 5, "z", 1, "dst", 4, "src1", 5, "src2", 6, END) },
+	{ "[A2] ldw",      asm_insn("ldw", "creg", 5, "z", 0, "dst", 4, "baseR", 10, "offsetR", 1, "mode", 1, END) },
+};
+
+/* Seconds of the fastest of 3 runs of a loop of copies copies of word for
+   iterations iterations, or -1 if the program did not end */
+double run_loop(tms62x_sim *sim, unsigned int word, int copies, long long iterations){
+
+	unsigned int words[64];
+	unsigned char image[sizeof(words)];
+	double best = -1;
+	int n = 0, branch;
+
+	//A1 counts the iterations; the loop starts at the second fetch packet
+	words[n++] = asm_insn("mvk", "dst", 1, "cst", (int)(iterations & 0xFFFF), END);
+	words[n++] = asm_insn("mvkh", "dst", 1, "cst", (int)(iterations >> 16 & 0xFFFF), END);
+	while( n < 8 )
+		words[n++] = asm_insn("nop", END);
+	for( int i = 0; i < copies; i++ )
+		words[n++] = word;
+	words[n++] = asm_insn("add_l_cii", "dst", 1, "src1", -1, "src2", 1, END);
+	branch = n;
+	words[n++] = asm_insn("b_lab", "creg", 4, "z", 0, "cst_b", 8 - (branch & ~7), END);
+	words[n++] = asm_insn("nop", "src", 4, END);
+	words[n++] = asm_insn("idle", END);
+	asm_image(image, words, n);
+
+	for( int r = 0; r < 3; r++ ){
+		struct timespec t0, t1;
+		double t;
+
+		tms62x_reset(sim);
+		if( tms62x_load(sim, image, 4 * n, 0) )
+			return -1;
+		tms62x_set_reg(sim, TMS62X_RB_A, 2, 1);
+		tms62x_set_reg(sim, TMS62X_RB_A, 5, REG_OPERAND1);
+		tms62x_set_reg(sim, TMS62X_RB_A, 6, REG_OPERAND2);
+		tms62x_set_reg(sim, TMS62X_RB_A, 10, REG_BASE);
+		tms62x_set_reg(sim, TMS62X_RB_B, 14, REG_BASE);
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		if( tms62x_run(sim, -1, -1) != TMS62X_DONE )
+			return -1;
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+
+		t = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+		if( best < 0 || t < best )
+			best = t;
+	}
+
+	return best;
+}
+
+int main(int argc, char *argv[]){
+
+	long long iterations = 200000;
+	tms62x_sim *sim;
+	double base;
+
+	if( argc > 1 )
+		iterations = atoll(argv[1]);
+	if( iterations < 1 || iterations > 0x7FFFFFFF ){
+		fprintf(stderr, "Usage: tms62x_bench [iterations]\n");
+		return 1;
+	}
+
+	if( !(sim = tms62x_create()) ){
+		fprintf(stderr, "Could not create the simulator\n");
+		return 1;
+	}
+
+	if( (base = run_loop(sim, 0, 0, iterations)) < 0 ){
+		fprintf(stderr, "The empty loop did not end\n");
+		return 1;
+	}
+
+	printf("%-14s %10s %10s\n", "instruction", "ns/insn", "Minsn/s");
+	for( unsigned int i = 0; i < sizeof(benches) / sizeof(benches[0]); i++ ){
+		double t = run_loop(sim, benches[i].word, UNROLL, iterations);
+		double ns;
+
+		if( t < 0 ){
+			printf("%-14s %10s\n", benches[i].label, "failed");
+			continue;
+		}
+		ns = (t - base) * 1e9 / (iterations * UNROLL);
+		printf("%-14s %10.2f %10.1f\n", benches[i].label, ns, ns > 0 ? 1e3 / ns : 0.0);
+	}
+
+	tms62x_destroy(sim);
+	return 0;
+}
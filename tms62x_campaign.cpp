@@ -0,0 +1,278 @@
+/**
+ * @file      tms62x_campaign.cpp
+ * @author    Sandro Rigo
+ *
+ *            The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br
+ *
+ * @version   1.0
+ *
+ * @brief     Runs one TMS320C62x program over a directory of input vectors.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Usage: tms62x_campaign [options] <image> <vector-dir> <results-file>
+//
+//   -l <addr>        Load address of the image (default 0)
+//   -i <addr>        Address where each input vector is written (default 0x100000)
+//   -o <addr>:<size> Output buffer whose checksum is reported (default 0x200000:4096)
+//   -c <cycles>      Cycle limit per vector (default: run to the end)
+//   -j <threads>     Worker threads (default: online CPUs)
+//
+// Every worker owns one simulator instance that is reset between vectors. The
+// vectors are split among per-worker deques; a worker takes work from the back
+// of its own deque and, when it is empty, steals from the front of another one.
+// The results file has one line per vector: name, output checksum and cycles.
+// A worker that cannot start its instance returns the error to main() and the
+// others take its vectors; the vectors no worker ran are reported as errors.
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#include  "tms62x_api.h"
+#include  <stdio.h>
+#include  <stdlib.h>
+#include  <string.h>
+#include  <unistd.h>
+#include  <dirent.h>
+#include  <pthread.h>
+#include  <deque>
+#include  <vector>
+#include  <string>
+#include  <algorithm>
+
+using namespace std;
+
+struct job_result {
+	unsigned long long checksum;
+	long long cycles;
+	int status;
+};
+
+//Work-stealing deque of a worker
+struct work_queue {
+	pthread_mutex_t lock;
+	deque<int> jobs;
+};
+
+//Campaign configuration
+unsigned int load_addr = 0;
+unsigned int in_addr = 0x100000;
+unsigned int out_addr = 0x200000;
+unsigned int out_size = 4096;
+long long max_cycles = -1;
+
+vector<unsigned char> image;
+vector<string> vectors;       //Paths of the input vectors
+vector<job_result> results;
+vector<work_queue> queues;
+
+/* Reads a whole file. Returns false on error. */
+bool read_file(const char *name, vector<unsigned char> &buf){
+
+	FILE *f = fopen(name, "rb");
+	long size;
+
+	if( !f )
+		return false;
+
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	buf.resize(size);
+	if( size && fread(&buf[0], 1, size, f) != (size_t)size ){
+		fclose(f);
+		return false;
+	}
+
+	fclose(f);
+	return true;
+}
+
+/* FNV-1a hash of the output buffer */
+unsigned long long checksum(const unsigned char *buf, unsigned int size){
+
+	unsigned long long h = 14695981039346656037ULL;
+
+	for( unsigned int i = 0; i < size; i++ ){
+		h ^= buf[i];
+		h *= 1099511628211ULL;
+	}
+
+	return h;
+}
+
+/* Takes the next job for worker id, stealing if its deque is empty. Returns -1 when
+   there is no work left. */
+int next_job(int id){
+
+	int job = -1;
+	int n = queues.size();
+
+	pthread_mutex_lock(&queues[id].lock);
+	if( !queues[id].jobs.empty() ){
+		job = queues[id].jobs.back();
+		queues[id].jobs.pop_back();
+	}
+	pthread_mutex_unlock(&queues[id].lock);
+
+	for( int i = 1; job < 0 && i < n; i++ ){
+		work_queue &victim = queues[(id + i) % n];
+
+		pthread_mutex_lock(&victim.lock);
+		if( !victim.jobs.empty() ){
+			job = victim.jobs.front();
+			victim.jobs.pop_front();
+		}
+		pthread_mutex_unlock(&victim.lock);
+	}
+
+	return job;
+}
+
+/* Worker thread. Returns non-null if its simulator instance could not be
+   started, without taking any vector. */
+void *worker(void *arg){
+
+	int id = (long)arg;
+	int job;
+	tms62x_sim *sim = tms62x_create();
+	vector<unsigned char> in, out(out_size);
+
+	if( !sim || tms62x_load(sim, &image[0], image.size(), load_addr) ){
+		if( sim )
+			tms62x_destroy(sim);
+		return (void *)1;
+	}
+
+	while( (job = next_job(id)) >= 0 ){
+		job_result &r = results[job];
+
+		tms62x_reset(sim);
+
+		if( !read_file(vectors[job].c_str(), in) ||
+				tms62x_write_mem(sim, in_addr, in.empty() ? 0 : &in[0], in.size()) ){
+			fprintf(stderr, "Could not load input vector %s\n", vectors[job].c_str());
+			r.status = TMS62X_ERROR;
+			continue;
+		}
+
+		r.status = tms62x_run(sim, max_cycles, -1);
+		r.cycles = tms62x_get_cycles(sim);
+
+		if( tms62x_read_mem(sim, out_addr, &out[0], out_size) ){
+			fprintf(stderr, "Could not read the output buffer of %s\n", vectors[job].c_str());
+			r.status = TMS62X_ERROR;
+			continue;
+		}
+		r.checksum = checksum(&out[0], out_size);
+	}
+
+	tms62x_destroy(sim);
+	return 0;
+}
+
+void usage(const char *prog){
+
+	fprintf(stderr, "Usage: %s [-l addr] [-i addr] [-o addr:size] [-c cycles] [-j threads] "
+					"<image> <vector-dir> <results-file>\n", prog);
+	exit(1);
+}
+
+int main(int argc, char *argv[]){
+
+	int opt, i, failed = 0;
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	DIR *dir;
+	struct dirent *ent;
+	FILE *out;
+
+	while( (opt = getopt(argc, argv, "l:i:o:c:j:")) != -1 ){
+		switch( opt ){
+		case 'l':
+			load_addr = strtoul(optarg, 0, 0);
+			break;
+		case 'i':
+			in_addr = strtoul(optarg, 0, 0);
+			break;
+		case 'o':
+			if( sscanf(optarg, "%i:%i", (int *)&out_addr, (int *)&out_size) != 2 )
+				usage(argv[0]);
+			break;
+		case 'c':
+			max_cycles = strtoll(optarg, 0, 0);
+			break;
+		case 'j':
+			threads = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if( argc - optind != 3 )
+		usage(argv[0]);
+	if( threads <= 0 )
+		threads = 1;
+
+	if( !read_file(argv[optind], image) || image.empty() ){
+		fprintf(stderr, "Could not read image %s\n", argv[optind]);
+		return 1;
+	}
+
+	if( !(dir = opendir(argv[optind + 1])) ){
+		perror(argv[optind + 1]);
+		return 1;
+	}
+	while( (ent = readdir(dir)) )
+		if( ent->d_name[0] != '.' )
+			vectors.push_back(string(argv[optind + 1]) + "/" + ent->d_name);
+	closedir(dir);
+	sort(vectors.begin(), vectors.end());
+
+	//A vector stays an error until a worker runs it
+	job_result none = { 0, 0, TMS62X_ERROR };
+	results.resize(vectors.size(), none);
+
+	//Distributing the vectors round-robin among the workers
+	queues.resize(threads);
+	for( i = 0; i < threads; i++ )
+		pthread_mutex_init(&queues[i].lock, 0);
+	for( i = 0; i < (int)vectors.size(); i++ )
+		queues[i % threads].jobs.push_back(i);
+
+	vector<pthread_t> tid(threads);
+	for( i = 0; i < threads; i++ )
+		pthread_create(&tid[i], 0, worker, (void *)(long)i);
+	for( i = 0; i < threads; i++ ){
+		void *ret;
+
+		pthread_join(tid[i], &ret);
+		if( ret ){
+			fprintf(stderr, "Worker %d: could not create the simulator instance or load the image.\n", i);
+			failed++;
+		}
+	}
+	if( failed == threads )
+		fprintf(stderr, "No worker started; every vector is reported as an error.\n");
+
+	if( !(out = fopen(argv[optind + 2], "w")) ){
+		perror(argv[optind + 2]);
+		return 1;
+	}
+	for( i = 0; i < (int)vectors.size(); i++ ){
+		if( results[i].status == TMS62X_ERROR )
+			fprintf(out, "%s error\n", vectors[i].c_str());
+		else
+			fprintf(out, "%s %016llx %lld\n", vectors[i].c_str(), results[i].checksum, results[i].cycles);
+	}
+	fclose(out);
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,562 @@
+/**
+ * @file      tms62x_decgen.cpp
+ * @author    Sandro Rigo
+ *
+ *            The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br
+ *
+ * @version   1.0
+ *
+ * @brief     Generates a two-level decoding table from the ISA description.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Usage: tms62x_decgen <isa.ac> <output.H>
+//
+// Reads the ac_format, ac_instr and set_decoder declarations of the ISA
+// description and turns every instruction into a mask/value pair over the
+// 32-bit word. The generated header maps a word to its instruction in two
+// table lookups:
+//
+//   level 1: the bits fixed by every instruction (the low opcode bits), which
+//            select the format group;
+//   level 2: a run of bits fixed by every instruction of the group, which
+//            selects the opcode.
+//
+// Each level 2 cell lists the candidates whose mask/value still has to be
+// checked, normally a single one. The header also has the field layout of
+// every format, a dec_operands structure with every field of every format and
+// an extractor per format that fills it from a word, and X-macro lists of the
+// formats and instructions so the model can build its behavior tables.
+//
+// Before writing the header the tables are verified: the candidates of every
+// cell must be exactly the instructions that can match some word of the cell,
+// in declaration order. The table lookup then gives the same instruction as a
+// linear scan for every one of the 2^32 words.
+//
+// Two instructions with the same encoding can never be told apart and are
+// reported as conflicts. Partial overlaps, where one word matches two
+// instructions, are reported as warnings; the first declared instruction wins,
+// like in the ArchC decoder. The program exits with status 2 when there are
+// conflicts, after writing the header.
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#include  <stdio.h>
+#include  <stdlib.h>
+#include  <string.h>
+#include  <ctype.h>
+#include  <map>
+#include  <vector>
+#include  <string>
+
+using namespace std;
+
+struct field {
+	string name;
+	int lsb;
+	int width;
+	int sign;
+};
+
+struct format {
+	string name;
+	vector<field> fields;
+};
+
+struct instr {
+	string name;
+	int fmt;
+	unsigned int mask;
+	unsigned int value;
+	int line;
+};
+
+vector<format> formats;
+map<string, int> format_id;
+vector<field> all_fields;  //Every field name, in order of appearance
+vector<instr> instrs;
+map<string, int> instr_id;
+
+/* Parses a format string such as "%creg:3 %z:1 %cst:16:s". The first field
+   holds the most significant bits. Returns false on error. */
+bool parse_format(const string &name, const char *str){
+
+	format f;
+	vector<field> fields;
+	int total = 0;
+
+	f.name = name;
+
+	for( const char *p = strchr(str, '%'); p; p = strchr(p + 1, '%') ){
+		char fname[64], sign[4] = "";
+		field fl;
+
+		if( sscanf(p, "%%%63[a-zA-Z0-9_]:%d:%1[s]", fname, &fl.width, sign) < 2 )
+			return false;
+
+		fl.name = fname;
+		fl.sign = sign[0] == 's';
+		total += fl.width;
+		fields.push_back(fl);
+	}
+
+	if( total != 32 )
+		return false;
+
+	//Assigning bit positions from the most significant field down
+	for( size_t i = 0; i < fields.size(); i++ ){
+		total -= fields[i].width;
+		fields[i].lsb = total;
+	}
+
+	//A field name has the same signedness in every format
+	for( size_t i = 0; i < fields.size(); i++ ){
+		size_t j;
+
+		for( j = 0; j < all_fields.size() && all_fields[j].name != fields[i].name; j++ )
+			;
+		if( j == all_fields.size() )
+			all_fields.push_back(fields[i]);
+		else if( all_fields[j].sign != fields[i].sign )
+			return false;
+	}
+
+	f.fields = fields;
+	format_id[name] = formats.size();
+	formats.push_back(f);
+	return true;
+}
+
+const field *find_field(const format &f, const string &name){
+
+	for( size_t i = 0; i < f.fields.size(); i++ )
+		if( f.fields[i].name == name )
+			return &f.fields[i];
+
+	return 0;
+}
+
+/* Parses the arguments of set_decoder, such as "op_l2=0x6, op_l=0x1A" */
+bool parse_decoder(instr &in, const char *args){
+
+	const format &f = formats[in.fmt];
+	char buf[256];
+
+	strncpy(buf, args, sizeof(buf) - 1);
+	buf[sizeof(buf) - 1] = 0;
+
+	for( char *tok = strtok(buf, ","); tok; tok = strtok(0, ",") ){
+		char fname[64];
+		unsigned int value;
+		unsigned int fmask;
+		const field *fl;
+
+		if( sscanf(tok, " %63[a-zA-Z0-9_] = %i", fname, (int *)&value) != 2 )
+			return false;
+		if( !(fl = find_field(f, fname)) ){
+			fprintf(stderr, "line %d: %s has no field %s\n", in.line, in.name.c_str(), fname);
+			return false;
+		}
+
+		fmask = (fl->width == 32 ? 0xFFFFFFFF : (1u << fl->width) - 1);
+		if( value & ~fmask ){
+			fprintf(stderr, "line %d: value %#x does not fit in field %s of %s\n", in.line, value,
+							fname, in.name.c_str());
+			return false;
+		}
+
+		in.mask |= fmask << fl->lsb;
+		in.value |= value << fl->lsb;
+	}
+
+	return true;
+}
+
+bool parse_isa(const char *name){
+
+	FILE *f = fopen(name, "r");
+	char line[1024];
+	int n = 0;
+
+	if( !f ){
+		perror(name);
+		return false;
+	}
+
+	while( fgets(line, sizeof(line), f) ){
+		char a[64], b[1024];
+		const char *p = line;
+
+		n++;
+		while( isspace(*p) )
+			p++;
+		if( p[0] == '/' && p[1] == '/' )
+			continue;
+
+		if( sscanf(p, "ac_format %63[a-zA-Z0-9_] = \"%1023[^\"]\"", a, b) == 2 ){
+			if( !parse_format(a, b) ){
+				fprintf(stderr, "%s:%d: invalid format %s\n", name, n, a);
+				return false;
+			}
+		}
+		else if( sscanf(p, "ac_instr < %63[a-zA-Z0-9_] > %1023[^;]", a, b) == 2 ||
+						 sscanf(p, "ac_instr<%63[a-zA-Z0-9_]> %1023[^;]", a, b) == 2 ){
+			if( !format_id.count(a) ){
+				fprintf(stderr, "%s:%d: unknown format %s\n", name, n, a);
+				return false;
+			}
+
+			for( char *tok = strtok(b, ", \t"); tok; tok = strtok(0, ", \t") ){
+				instr in;
+
+				in.name = tok;
+				in.fmt = format_id[a];
+				in.mask = in.value = 0;
+				in.line = n;
+				instr_id[tok] = instrs.size();
+				instrs.push_back(in);
+			}
+		}
+		else if( sscanf(p, "%63[a-zA-Z0-9_].set_decoder ( %1023[^)]", a, b) == 2 ){
+			if( !instr_id.count(a) ){
+				fprintf(stderr, "%s:%d: unknown instruction %s\n", name, n, a);
+				return false;
+			}
+
+			instr &in = instrs[instr_id[a]];
+			in.line = n;
+			if( !parse_decoder(in, b) ){
+				fprintf(stderr, "%s:%d: invalid decoder for %s\n", name, n, a);
+				return false;
+			}
+		}
+	}
+
+	fclose(f);
+	return true;
+}
+
+/* Reports identical encodings and overlaps. Returns the number of conflicts. */
+int check_conflicts(){
+
+	int conflicts = 0;
+
+	for( size_t i = 0; i < instrs.size(); i++ )
+		for( size_t j = i + 1; j < instrs.size(); j++ ){
+			const instr &a = instrs[i], &b = instrs[j];
+			unsigned int common = a.mask & b.mask;
+
+			if( (a.value & common) != (b.value & common) )
+				continue;
+
+			if( a.mask == b.mask ){
+				fprintf(stderr, "conflict: %s (line %d) and %s (line %d) have the same encoding %#010x/%#010x\n",
+								a.name.c_str(), a.line, b.name.c_str(), b.line, a.value, a.mask);
+				conflicts++;
+			}
+			else
+				fprintf(stderr, "warning: %s (line %d) and %s (line %d) overlap, %s is decoded first\n",
+								a.name.c_str(), a.line, b.name.c_str(), b.line, a.name.c_str());
+		}
+
+	return conflicts;
+}
+
+/* Longest run of set bits in mask, at most 8 bits wide. Returns its width. */
+int longest_run(unsigned int mask, int &lsb){
+
+	int best = 0;
+
+	lsb = 0;
+	for( int i = 0; i < 32; ){
+		if( !(mask >> i & 1) ){
+			i++;
+			continue;
+		}
+
+		int j = i;
+		while( j < 32 && (mask >> j & 1) )
+			j++;
+		if( j - i > best ){
+			best = j - i;
+			lsb = i;
+		}
+		i = j;
+	}
+
+	if( best > 8 ){
+		//Keeping the lowest bits of the run
+		best = 8;
+	}
+
+	return best;
+}
+
+//A level 1 group: the level 2 field and the candidates of each level 2 cell
+struct group {
+	int lsb;
+	int width;
+	vector< vector<int> > cells;
+};
+
+/* Checks that the candidates of every level 2 cell are the instructions that
+   match some word of the cell, in declaration order. An instruction matches a
+   word of the cell when its value agrees with the cell on the bits that both
+   fix. Returns the number of wrong cells. */
+int verify_tables(int l1_lsb, int l1_width, const vector<group> &groups){
+
+	unsigned int l1_mask = (l1_width ? ((1u << l1_width) - 1) << l1_lsb : 0);
+	int wrong = 0;
+
+	for( size_t k = 0; k < groups.size(); k++ ){
+		const group &g = groups[k];
+		unsigned int cmask = (g.width ? ((1u << g.width) - 1) << g.lsb : 0);
+
+		for( size_t c = 0; c < g.cells.size(); c++ ){
+			unsigned int fixed = l1_mask | cmask;
+			unsigned int value = (k << l1_lsb) | (c << g.lsb);
+			vector<int> match;
+
+			for( size_t i = 0; i < instrs.size(); i++ )
+				if( !((instrs[i].value ^ value) & instrs[i].mask & fixed) )
+					match.push_back(i);
+
+			if( match != g.cells[c] ){
+				fprintf(stderr, "error: cell %d of group %d has the wrong candidates\n", (int)c, (int)k);
+				wrong++;
+			}
+		}
+	}
+
+	return wrong;
+}
+
+bool write_header(const char *name, int l1_lsb, int l1_width, const vector<group> &groups){
+
+	FILE *f = fopen(name, "w");
+	vector<int> l2_base, cand_base;
+	vector<int> cands;
+	int l2_size = 0;
+
+	if( !f ){
+		perror(name);
+		return false;
+	}
+
+	fprintf(f, "/* Generated by tms62x_decgen from the ISA description. Do not edit. */\n\n");
+	fprintf(f, "#ifndef TMS62X_DECODE_H\n#define TMS62X_DECODE_H\n\n");
+
+	//Formats and their fields
+	fprintf(f, "enum {\n");
+	for( size_t i = 0; i < formats.size(); i++ )
+		fprintf(f, "\tDEC_FMT_%s,\n", formats[i].name.c_str());
+	fprintf(f, "\tDEC_FORMATS\n};\n\n");
+
+	fprintf(f, "struct dec_field {\n\tconst char *name;\n\tunsigned char lsb;\n\tunsigned char width;\n"
+					"\tunsigned char sign;\n};\n\n");
+	for( size_t i = 0; i < formats.size(); i++ ){
+		const format &fm = formats[i];
+
+		fprintf(f, "static const dec_field dec_fields_%s[] = {\n", fm.name.c_str());
+		for( size_t j = 0; j < fm.fields.size(); j++ )
+			fprintf(f, "\t{ \"%s\", %d, %d, %d },\n", fm.fields[j].name.c_str(), fm.fields[j].lsb,
+							fm.fields[j].width, fm.fields[j].sign);
+		fprintf(f, "\t{ 0, 0, 0, 0 }\n};\n\n");
+	}
+
+	fprintf(f, "//Field layout of each format, ending with a null name\n");
+	fprintf(f, "static const dec_field *const dec_format_fields[DEC_FORMATS] = {\n");
+	for( size_t i = 0; i < formats.size(); i++ )
+		fprintf(f, "\tdec_fields_%s,\n", formats[i].name.c_str());
+	fprintf(f, "};\n\n");
+
+	//Every field of every format, signed fields as int
+	fprintf(f, "//Operand fields of a decoded word, filled by the extractor of its format\n");
+	fprintf(f, "struct dec_operands {\n");
+	for( size_t i = 0; i < all_fields.size(); i++ )
+		fprintf(f, "\t%s %s;\n", all_fields[i].sign ? "int" : "unsigned int", all_fields[i].name.c_str());
+	fprintf(f, "};\n\n");
+
+	fprintf(f, "//Every operand field, as X(field)\n");
+	fprintf(f, "#define DEC_FIELD_LIST(X)");
+	for( size_t i = 0; i < all_fields.size(); i++ )
+		fprintf(f, " \\\n\tX(%s)", all_fields[i].name.c_str());
+	fprintf(f, "\n\n");
+
+	for( size_t i = 0; i < formats.size(); i++ ){
+		const format &fm = formats[i];
+
+		fprintf(f, "inline void dec_extract_%s(dec_operands &o, unsigned int w){\n\n", fm.name.c_str());
+		for( size_t j = 0; j < fm.fields.size(); j++ ){
+			const field &fl = fm.fields[j];
+
+			if( fl.sign )
+				fprintf(f, "\to.%s = (int)(w << %d) >> %d;\n", fl.name.c_str(), 32 - fl.lsb - fl.width,
+								32 - fl.width);
+			else
+				fprintf(f, "\to.%s = (w >> %d) & %#x;\n", fl.name.c_str(), fl.lsb,
+								fl.width == 32 ? 0xFFFFFFFF : (1u << fl.width) - 1);
+		}
+		fprintf(f, "}\n\n");
+	}
+
+	fprintf(f, "//Extractor of each format\n");
+	fprintf(f, "static void (*const dec_extractors[DEC_FORMATS])(dec_operands &, unsigned int) = {\n");
+	for( size_t i = 0; i < formats.size(); i++ )
+		fprintf(f, "\tdec_extract_%s,\n", formats[i].name.c_str());
+	fprintf(f, "};\n\n");
+
+	fprintf(f, "//Every format, as X(format)\n");
+	fprintf(f, "#define DEC_FORMAT_LIST(X)");
+	for( size_t i = 0; i < formats.size(); i++ )
+		fprintf(f, " \\\n\tX(%s)", formats[i].name.c_str());
+	fprintf(f, "\n\n");
+
+	//Instructions
+	fprintf(f, "enum {\n");
+	for( size_t i = 0; i < instrs.size(); i++ )
+		fprintf(f, "\tDEC_%s,\n", instrs[i].name.c_str());
+	fprintf(f, "\tDEC_INSTRS\n};\n\n");
+
+	fprintf(f, "struct dec_instr {\n\tconst char *name;\n\tint format;\n\tunsigned int mask;\n"
+					"\tunsigned int value;\n};\n\n");
+	fprintf(f, "static const dec_instr dec_instrs[DEC_INSTRS] = {\n");
+	for( size_t i = 0; i < instrs.size(); i++ )
+		fprintf(f, "\t{ \"%s\", DEC_FMT_%s, %#010x, %#010x },\n", instrs[i].name.c_str(),
+						formats[instrs[i].fmt].name.c_str(), instrs[i].mask, instrs[i].value);
+	fprintf(f, "};\n\n");
+
+	fprintf(f, "//Every instruction with its format, as X(instruction, format)\n");
+	fprintf(f, "#define DEC_INSTR_LIST(X)");
+	for( size_t i = 0; i < instrs.size(); i++ )
+		fprintf(f, " \\\n\tX(%s, %s)", instrs[i].name.c_str(), formats[instrs[i].fmt].name.c_str());
+	fprintf(f, "\n\n");
+
+	//Flattening the tables
+	for( size_t g = 0; g < groups.size(); g++ ){
+		l2_base.push_back(l2_size);
+		for( size_t c = 0; c < groups[g].cells.size(); c++ ){
+			cand_base.push_back(cands.size());
+			cands.insert(cands.end(), groups[g].cells[c].begin(), groups[g].cells[c].end());
+			cands.push_back(-1);
+		}
+		l2_size += groups[g].cells.size();
+	}
+
+	fprintf(f, "#define DEC_L1_LSB    %d\n#define DEC_L1_WIDTH  %d\n\n", l1_lsb, l1_width);
+
+	fprintf(f, "//Level 1: the level 2 field (lsb, width) and the first level 2 cell of each group\n");
+	fprintf(f, "struct dec_group {\n\tunsigned char lsb;\n\tunsigned char width;\n\tunsigned short base;\n};\n\n");
+	fprintf(f, "static const dec_group dec_level1[1 << DEC_L1_WIDTH] = {\n");
+	for( size_t g = 0; g < groups.size(); g++ )
+		fprintf(f, "\t{ %d, %d, %d },\n", groups[g].lsb, groups[g].width, l2_base[g]);
+	fprintf(f, "};\n\n");
+
+	fprintf(f, "//Level 2: the first candidate of each cell\n");
+	fprintf(f, "static const unsigned short dec_level2[%d] = {", l2_size);
+	for( size_t i = 0; i < cand_base.size(); i++ )
+		fprintf(f, "%s%d,", i % 16 ? " " : "\n\t", cand_base[i]);
+	fprintf(f, "\n};\n\n");
+
+	fprintf(f, "//Candidate instructions of the cells, each list ending with -1\n");
+	fprintf(f, "static const short dec_candidates[%d] = {", (int)cands.size());
+	for( size_t i = 0; i < cands.size(); i++ )
+		fprintf(f, "%s%d,", i % 16 ? " " : "\n\t", cands[i]);
+	fprintf(f, "\n};\n\n");
+
+	fprintf(f, "/* Returns the instruction (DEC_*) encoded by word, or -1 */\n");
+	fprintf(f, "inline int tms62x_decode(unsigned int word){\n\n");
+	fprintf(f, "\tconst dec_group &g = dec_level1[(word >> DEC_L1_LSB) & ((1 << DEC_L1_WIDTH) - 1)];\n");
+	fprintf(f, "\tconst short *c = dec_candidates + dec_level2[g.base + ((word >> g.lsb) & ((1 << g.width) - 1))];\n\n");
+	fprintf(f, "\tfor( ; *c >= 0; c++ )\n");
+	fprintf(f, "\t\tif( (word & dec_instrs[*c].mask) == dec_instrs[*c].value )\n");
+	fprintf(f, "\t\t\treturn *c;\n\n");
+	fprintf(f, "\treturn -1;\n}\n\n");
+
+	fprintf(f, "/* Extracts a field of a decoded word */\n");
+	fprintf(f, "inline int dec_extract(unsigned int word, const dec_field &fl){\n\n");
+	fprintf(f, "\tunsigned int v = (word >> fl.lsb) & (fl.width == 32 ? 0xFFFFFFFF : (1u << fl.width) - 1);\n\n");
+	fprintf(f, "\tif( fl.sign && fl.width < 32 && (v >> (fl.width - 1)) )\n");
+	fprintf(f, "\t\tv |= ~0u << fl.width;\n\n");
+	fprintf(f, "\treturn (int)v;\n}\n\n");
+
+	fprintf(f, "#endif\n");
+
+	fclose(f);
+	return true;
+}
+
+int main(int argc, char *argv[]){
+
+	unsigned int common = 0xFFFFFFFF;
+	int l1_lsb, l1_width, conflicts;
+	vector<group> groups;
+
+	if( argc != 3 ){
+		fprintf(stderr, "Usage: %s <isa.ac> <output.H>\n", argv[0]);
+		return 1;
+	}
+
+	if( !parse_isa(argv[1]) )
+		return 1;
+
+	for( size_t i = 0; i < instrs.size(); i++ ){
+		if( !instrs[i].mask ){
+			fprintf(stderr, "%s has no decoder\n", instrs[i].name.c_str());
+			return 1;
+		}
+		common &= instrs[i].mask;
+	}
+
+	conflicts = check_conflicts();
+
+	//Level 1 uses the bits fixed by every instruction
+	l1_width = longest_run(common, l1_lsb);
+	unsigned int l1_mask = (l1_width ? ((1u << l1_width) - 1) << l1_lsb : 0);
+
+	groups.resize(1 << l1_width);
+	for( size_t k = 0; k < groups.size(); k++ ){
+		group &g = groups[k];
+		unsigned int key = k << l1_lsb;
+		unsigned int inter = 0xFFFFFFFF;
+		vector<int> members;
+
+		for( size_t i = 0; i < instrs.size(); i++ )
+			if( (instrs[i].value & l1_mask) == key ){
+				members.push_back(i);
+				inter &= instrs[i].mask;
+			}
+
+		//Level 2 uses bits fixed by every member of the group
+		g.width = members.size() > 1 ? longest_run(inter & ~l1_mask, g.lsb) : 0;
+		if( !g.width )
+			g.lsb = 0;
+
+		g.cells.resize(1 << g.width);
+		for( size_t c = 0; c < g.cells.size(); c++ ){
+			unsigned int cmask = (g.width ? ((1u << g.width) - 1) << g.lsb : 0);
+
+			for( size_t m = 0; m < members.size(); m++ )
+				if( (instrs[members[m]].value & cmask) == (c << g.lsb) )
+					g.cells[c].push_back(members[m]);
+		}
+	}
+
+	if( verify_tables(l1_lsb, l1_width, groups) )
+		return 1;
+
+	if( !write_header(argv[2], l1_lsb, l1_width, groups) )
+		return 1;
+
+	fprintf(stderr, "%d formats, %d instructions, %d conflicts\n", (int)formats.size(),
+					(int)instrs.size(), conflicts);
+
+	return conflicts ? 2 : 0;
+}
@@ -0,0 +1,331 @@
+/**
+ * @file      tms62x_server.cpp
+ * @author    Sandro Rigo
+ *
+ *            The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br
+ *
+ * @version   1.0
+ *
+ * @brief     TMS320C62x simulation server with a pool of booted instances.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Usage: tms62x_server [options] <socket> <image>
+//
+//   -l <addr>    Load address of the image (default 0)
+//   -b <pc>      Run the boot code up to this address before accepting jobs
+//   -n <count>   Instances in the pool (default: online CPUs)
+//
+// The image is loaded and booted once into a checkpoint instance. Every job
+// takes an instance from the pool, copies the checkpoint into it, writes the
+// input, runs and sends back the output buffer and the statistics of the job.
+// The protocol is described in tms62x_server.h. Each client connection is
+// served by its own thread.
+//
+// The boot code runs only once, but the checkpoint copy is not free: every job
+// copies the whole state, the TMS62X_MEM_SIZE bytes of memory (5 MB) and the
+// caches included, whatever the previous job wrote. That is about 0.3 ms per
+// job on a current host, on top of the job run itself. The decoded program is
+// shared with the checkpoint and not copied.
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#include  "tms62x_server.h"
+#include  <stdio.h>
+#include  <stdlib.h>
+#include  <string.h>
+#include  <unistd.h>
+#include  <signal.h>
+#include  <pthread.h>
+#include  <sys/socket.h>
+#include  <sys/un.h>
+#include  <vector>
+
+using namespace std;
+
+tms62x_sim *boot;           //Checkpoint every job starts from
+tms62x_stats boot_stats;
+long long boot_cycles;
+
+//Pool of free instances
+vector<tms62x_sim *> pool;
+pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t pool_cond = PTHREAD_COND_INITIALIZER;
+
+tms62x_sim *pool_get(){
+
+	tms62x_sim *sim;
+
+	pthread_mutex_lock(&pool_lock);
+	while( pool.empty() )
+		pthread_cond_wait(&pool_cond, &pool_lock);
+	sim = pool.back();
+	pool.pop_back();
+	pthread_mutex_unlock(&pool_lock);
+
+	return sim;
+}
+
+void pool_put(tms62x_sim *sim){
+
+	pthread_mutex_lock(&pool_lock);
+	pool.push_back(sim);
+	pthread_cond_signal(&pool_cond);
+	pthread_mutex_unlock(&pool_lock);
+}
+
+/* Reads or writes exactly size bytes. Returns false on error or end of connection. */
+bool read_all(int fd, void *buf, size_t size){
+
+	char *p = (char *)buf;
+
+	while( size ){
+		ssize_t n = read(fd, p, size);
+		if( n <= 0 )
+			return false;
+		p += n;
+		size -= n;
+	}
+
+	return true;
+}
+
+bool write_all(int fd, const void *buf, size_t size){
+
+	const char *p = (const char *)buf;
+
+	while( size ){
+		ssize_t n = write(fd, p, size);
+		if( n <= 0 )
+			return false;
+		p += n;
+		size -= n;
+	}
+
+	return true;
+}
+
+/* Runs one job on a pool instance and fills the reply and the output buffer */
+void run_job(const tms62x_job &job, vector<unsigned char> &in, tms62x_reply &reply,
+						 vector<unsigned char> &out){
+
+	tms62x_sim *sim = pool_get();
+
+	out.resize(job.out_size);
+	memset(&reply, 0, sizeof(reply));
+
+	if( tms62x_copy_state(sim, boot) ||
+			tms62x_write_mem(sim, job.in_addr, in.empty() ? 0 : &in[0], in.size()) ){
+		reply.status = TMS62X_ERROR;
+		out.clear();
+		pool_put(sim);
+		return;
+	}
+
+	reply.status = tms62x_run(sim, job.max_cycles, -1);
+	reply.cycles = tms62x_get_cycles(sim) - boot_cycles;
+
+	//Statistics of the job alone
+	tms62x_get_stats(sim, &reply.stats);
+	reply.stats.instrs -= boot_stats.instrs;
+	reply.stats.cycles -= boot_stats.cycles;
+	for( int i = 0; i < 4; i++ )
+		reply.stats.unit[i] -= boot_stats.unit[i];
+	reply.stats.loads -= boot_stats.loads;
+	reply.stats.stores -= boot_stats.stores;
+	reply.stats.stalls -= boot_stats.stalls;
+	reply.stats.bank_stalls -= boot_stats.bank_stalls;
+	for( int i = 0; i < 3; i++ ){
+		reply.stats.hits[i] -= boot_stats.hits[i];
+		reply.stats.misses[i] -= boot_stats.misses[i];
+	}
+
+	if( job.out_size && tms62x_read_mem(sim, job.out_addr, &out[0], job.out_size) ){
+		reply.status = TMS62X_ERROR;
+		out.clear();
+	}
+	reply.out_size = out.size();
+
+	pool_put(sim);
+}
+
+/* Whether size bytes at addr fit in the address space and in the memory of an
+   instance */
+bool valid_range(unsigned int addr, unsigned int size){
+
+	return size <= TMS62X_MEM_SIZE && addr + size >= addr;
+}
+
+/* Client connection thread */
+void *client(void *arg){
+
+	int fd = (long)arg;
+	tms62x_job job;
+	tms62x_reply reply;
+	vector<unsigned char> in, out;
+
+	while( read_all(fd, &job, sizeof(job)) ){
+		if( job.magic != TMS62X_JOB_MAGIC ){
+			fprintf(stderr, "Invalid job header, closing connection.\n");
+			break;
+		}
+
+		//An input larger than the memory is not read, so the connection is lost
+		if( job.in_size > TMS62X_MEM_SIZE ){
+			fprintf(stderr, "Job input of %u bytes is larger than the memory, closing connection.\n",
+							job.in_size);
+			break;
+		}
+
+		in.resize(job.in_size);
+		if( job.in_size && !read_all(fd, &in[0], job.in_size) )
+			break;
+
+		if( valid_range(job.in_addr, job.in_size) && valid_range(job.out_addr, job.out_size) )
+			run_job(job, in, reply, out);
+		else {
+			memset(&reply, 0, sizeof(reply));
+			reply.status = TMS62X_ERROR;
+			out.clear();
+		}
+
+		if( !write_all(fd, &reply, sizeof(reply)) ||
+				(reply.out_size && !write_all(fd, &out[0], reply.out_size)) )
+			break;
+	}
+
+	close(fd);
+	return 0;
+}
+
+/* Reads a whole file. Returns false on error. */
+bool read_file(const char *name, vector<unsigned char> &buf){
+
+	FILE *f = fopen(name, "rb");
+	long size;
+
+	if( !f )
+		return false;
+
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	buf.resize(size);
+	if( size && fread(&buf[0], 1, size, f) != (size_t)size ){
+		fclose(f);
+		return false;
+	}
+
+	fclose(f);
+	return true;
+}
+
+void usage(const char *prog){
+
+	fprintf(stderr, "Usage: %s [-l addr] [-b boot-pc] [-n instances] <socket> <image>\n", prog);
+	exit(1);
+}
+
+int main(int argc, char *argv[]){
+
+	int opt, i, fd;
+	int count = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int load_addr = 0;
+	long long boot_pc = -1;
+	vector<unsigned char> image;
+	struct sockaddr_un addr;
+
+	while( (opt = getopt(argc, argv, "l:b:n:")) != -1 ){
+		switch( opt ){
+		case 'l':
+			load_addr = strtoul(optarg, 0, 0);
+			break;
+		case 'b':
+			boot_pc = strtoll(optarg, 0, 0);
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if( argc - optind != 2 )
+		usage(argv[0]);
+	if( count <= 0 )
+		count = 1;
+
+	if( !read_file(argv[optind + 1], image) || image.empty() ){
+		fprintf(stderr, "Could not read image %s\n", argv[optind + 1]);
+		return 1;
+	}
+
+	//Building the checkpoint
+	boot = tms62x_create();
+	if( !boot || tms62x_load(boot, &image[0], image.size(), load_addr) ){
+		fprintf(stderr, "Could not load the image.\n");
+		return 1;
+	}
+	if( boot_pc >= 0 && tms62x_run(boot, -1, boot_pc) != TMS62X_PC ){
+		fprintf(stderr, "The boot code did not reach %#llx.\n", boot_pc);
+		return 1;
+	}
+	boot_cycles = tms62x_get_cycles(boot);
+	tms62x_get_stats(boot, &boot_stats);
+
+	for( i = 0; i < count; i++ ){
+		tms62x_sim *sim = tms62x_create();
+		if( !sim ){
+			fprintf(stderr, "Could not create the instance pool.\n");
+			return 1;
+		}
+		pool.push_back(sim);
+	}
+
+	//Listening
+	signal(SIGPIPE, SIG_IGN);
+
+	if( (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ){
+		perror("socket");
+		return 1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, argv[optind], sizeof(addr.sun_path) - 1);
+	unlink(addr.sun_path);
+
+	if( bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 64) < 0 ){
+		perror(argv[optind]);
+		return 1;
+	}
+
+	fprintf(stderr, "Serving %s with %d instances on %s\n", argv[optind + 1], count, argv[optind]);
+
+	for(;;){
+		int cfd = accept(fd, 0, 0);
+		pthread_t tid;
+
+		if( cfd < 0 ){
+			perror("accept");
+			continue;
+		}
+
+		if( pthread_create(&tid, 0, client, (void *)(long)cfd) ){
+			close(cfd);
+			continue;
+		}
+		pthread_detach(tid);
+	}
+
+	return 0;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file      tms62x_server.h
+ * @author    Sandro Rigo
+ *
+ *            The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br
+ *
+ * @version   1.0
+ *
+ * @brief     Protocol of the TMS320C62x simulation server.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+#ifndef TMS62X_SERVER_H
+#define TMS62X_SERVER_H
+
+#include  "tms62x_api.h"
+
+/* A client connects to the server Unix socket and sends any number of jobs,
+   each one a request header followed by in_size bytes of input. The server
+   answers every job with a reply header followed by out_size bytes of output.
+   All fields are in host byte order. The input and output buffers are at most
+   TMS62X_MEM_SIZE bytes and must not wrap around the address space; a job
+   outside these limits gets a TMS62X_ERROR reply without running, and an
+   in_size over the limit closes the connection. */
+
+#define TMS62X_JOB_MAGIC 0x54363241  /* "T62A" */
+
+typedef struct {
+	unsigned int magic;
+	unsigned int in_addr;    /* Where the input is written */
+	unsigned int in_size;
+	unsigned int out_addr;   /* Output buffer returned in the reply */
+	unsigned int out_size;
+	unsigned int pad;
+	long long max_cycles;    /* -1 runs to the end */
+} tms62x_job;
+
+typedef struct {
+	int status;              /* tms62x_run() result, TMS62X_ERROR on a bad job */
+	unsigned int out_size;
+	long long cycles;        /* Cycles run by this job */
+	tms62x_stats stats;
+} tms62x_reply;
+
+#endif
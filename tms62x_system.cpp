@@ -0,0 +1,215 @@
+/**
+ * @file      tms62x_system.cpp
+ * @author    Sandro Rigo
+ *
+ *            The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br
+ *
+ * @version   1.0
+ *
+ * @brief     Several TMS320C62x cores sharing a memory region.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Usage: tms62x_system [options] <image>@<addr> [<image>@<addr> ...]
+//
+//   -s <base>:<size>  Shared region (default 0x400000:0x100000)
+//   -l <cycles>       Latency of each shared access (default 1)
+//   -p <cycles>       Arbitration penalty when the previous access came from another core (default 2)
+//   -q <cycles>       Synchronization quantum (default 1000)
+//   -c <cycles>       Cycle limit per core (default: run to the end)
+//
+// Each image runs on its own core, numbered in command line order, on its own
+// host thread. The cores meet at a barrier every quantum, so none of them runs
+// more than one quantum ahead of the others, and run in parallel in between.
+// Every core has its own memory, so images may be loaded at the same address.
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#include  "tms62x_api.h"
+#include  <stdio.h>
+#include  <stdlib.h>
+#include  <string.h>
+#include  <unistd.h>
+#include  <pthread.h>
+#include  <vector>
+
+using namespace std;
+
+struct core {
+	tms62x_sim *sim;
+	int done;
+};
+
+vector<core> cores;
+long long quantum = 1000;
+long long max_cycles = -1;
+
+pthread_barrier_t barrier;
+pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER;
+int running;  //Cores that have not finished yet
+
+/* Core thread: one quantum per barrier round, until every core is done.
+
+   Each core runs a whole quantum on its own thread, not one instruction at a
+   time in lockstep with the others. A lockstep loop over the cores in one
+   thread was tried and was 10 to 30% slower (80-100 against 105-119 Mcycles/s):
+   decoding is cached per fetch packet, so switching cores at every instruction
+   loses more than it saves. Lockstep would only pay off with the registers of
+   all cores laid out as arrays by register (one array per register, indexed
+   by core). */
+void *core_thread(void *arg){
+
+	core &c = cores[(long)arg];
+
+	for(;;){
+		if( !c.done ){
+			long long left = max_cycles - tms62x_get_cycles(c.sim);
+			int ret;
+
+			if( max_cycles >= 0 && left < quantum )
+				ret = tms62x_run(c.sim, left, -1);
+			else
+				ret = tms62x_run(c.sim, quantum, -1);
+
+			if( ret != TMS62X_CYCLES || (max_cycles >= 0 && tms62x_get_cycles(c.sim) >= max_cycles) ){
+				c.done = 1;
+				pthread_mutex_lock(&done_lock);
+				running--;
+				pthread_mutex_unlock(&done_lock);
+			}
+		}
+
+		pthread_barrier_wait(&barrier);
+
+		//Every core sees the same count after the first barrier
+		pthread_mutex_lock(&done_lock);
+		int left = running;
+		pthread_mutex_unlock(&done_lock);
+
+		pthread_barrier_wait(&barrier);
+
+		if( !left )
+			break;
+	}
+
+	return 0;
+}
+
+/* Reads a whole file. Returns false on error. */
+bool read_file(const char *name, vector<unsigned char> &buf){
+
+	FILE *f = fopen(name, "rb");
+	long size;
+
+	if( !f )
+		return false;
+
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	buf.resize(size);
+	if( size && fread(&buf[0], 1, size, f) != (size_t)size ){
+		fclose(f);
+		return false;
+	}
+
+	fclose(f);
+	return true;
+}
+
+void usage(const char *prog){
+
+	fprintf(stderr, "Usage: %s [-s base:size] [-l latency] [-p penalty] [-q quantum] [-c cycles] "
+					"<image>@<addr> ...\n", prog);
+	exit(1);
+}
+
+int main(int argc, char *argv[]){
+
+	int opt, i, n;
+	unsigned int base = 0x400000, size = 0x100000;
+	int latency = 1, penalty = 2;
+	tms62x_shared *sh;
+
+	while( (opt = getopt(argc, argv, "s:l:p:q:c:")) != -1 ){
+		switch( opt ){
+		case 's':
+			if( sscanf(optarg, "%i:%i", (int *)&base, (int *)&size) != 2 )
+				usage(argv[0]);
+			break;
+		case 'l':
+			latency = atoi(optarg);
+			break;
+		case 'p':
+			penalty = atoi(optarg);
+			break;
+		case 'q':
+			quantum = strtoll(optarg, 0, 0);
+			break;
+		case 'c':
+			max_cycles = strtoll(optarg, 0, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	n = argc - optind;
+	if( n <= 0 || n > 8 || quantum <= 0 )
+		usage(argv[0]);
+
+	if( !(sh = tms62x_shared_create(base, size, latency, penalty)) ){
+		fprintf(stderr, "Invalid shared region.\n");
+		return 1;
+	}
+
+	cores.resize(n);
+	for( i = 0; i < n; i++ ){
+		char *arg = argv[optind + i];
+		char *at = strrchr(arg, '@');
+		vector<unsigned char> image;
+
+		if( !at )
+			usage(argv[0]);
+		*at = 0;
+
+		cores[i].done = 0;
+		cores[i].sim = tms62x_create();
+		if( !cores[i].sim || !read_file(arg, image) || image.empty() ||
+				tms62x_load(cores[i].sim, &image[0], image.size(), strtoul(at + 1, 0, 0)) ||
+				tms62x_attach(cores[i].sim, sh, i) ){
+			fprintf(stderr, "Could not load %s on core %d\n", arg, i);
+			return 1;
+		}
+	}
+
+	running = n;
+	pthread_barrier_init(&barrier, 0, n);
+
+	vector<pthread_t> tid(n);
+	for( i = 0; i < n; i++ )
+		pthread_create(&tid[i], 0, core_thread, (void *)(long)i);
+	for( i = 0; i < n; i++ )
+		pthread_join(tid[i], 0);
+
+	for( i = 0; i < n; i++ ){
+		tms62x_stats st;
+
+		tms62x_get_stats(cores[i].sim, &st);
+		printf("Core %d: %lld cycles, %lld instructions, %lld loads, %lld stores, "
+					 "%lld stall cycles (%lld bank conflicts)\n", i, tms62x_get_cycles(cores[i].sim),
+					 st.instrs, st.loads, st.stores, st.stalls, st.bank_stalls);
+		tms62x_destroy(cores[i].sim);
+	}
+
+	tms62x_shared_destroy(sh);
+	return 0;
+}
@@ -0,0 +1,910 @@
+/**
+ * @file      tms62x_test.cpp
+ * @author    Sandro Rigo
+ *
+ *            The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br
+ *
+ * @version   1.0
+ *
+ * @brief     Checks the kernels of tms62x_kernels.H against plain reference
+ *            implementations.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Usage: tms62x_test [iterations]
+//
+// Built with the library by "make -f Makefile.lib check", which also runs it.
+// The reference implementations follow the manual, bit by bit, the way the
+// behaviors used to be written, and the table decoder is compared with a
+// linear scan of the encodings. The instructions on 40-bit values, the
+// multiplies, the 32-bit shifts, the address arithmetic and the loads in
+// linear and circular mode are then run through the library, decoder and
+// behaviors, and compared with 64-bit references. The decoded program shared
+// by instances is checked to stay apart from what each one runs. Random
+// operands come from a fixed seed, so a failure can be reproduced. Exits with
+// status 1 if any check fails.
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#include  "tms62x_kernels.H"
+#include  "tms62x_decode.H"
+#include  "tms62x_asm.H"
+#include  "tms62x_api.h"
+#include  <stdio.h>
+#include  <stdlib.h>
+#include  <string.h>
+#include  <stdarg.h>
+#include  <stddef.h>
+
+//Context of the kernel checks; the library runs its instances in their own
+tms62x_ctx test_ctx;
+
+long long iterations = 1000000;
+int failures = 0;
+
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ULL;
+
+/* xorshift64* generator */
+unsigned long long rng(){
+
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+/* Random 32-bit value, biased towards the edge cases of the kernels: zero,
+   all ones, single bits and values near the limits */
+unsigned int rng_word(){
+
+	unsigned long long r = rng();
+
+	switch( r & 7 ){
+	case 0:
+		return 0;
+	case 1:
+		return 0xFFFFFFFF;
+	case 2:
+		return 1u << (r >> 8 & 31);
+	case 3:
+		return ~(1u << (r >> 8 & 31));
+	default:
+		return (unsigned int)(r >> 32);
+	}
+}
+
+/* Reports a failure, up to 10 per test */
+void fail(const char *test, const char *fmt, ...){
+
+	static const char *last = 0;
+	static int count = 0;
+	va_list args;
+
+	failures++;
+	if( test != last ){
+		last = test;
+		count = 0;
+	}
+	if( ++count > 10 )
+		return;
+
+	fprintf(stderr, "%s: ", test);
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	fprintf(stderr, "\n");
+}
+
+/*--------------------------------------------------------------------------------*/
+//Register pairs
+
+/* The 40-bit value of a pair, assembled from its two registers */
+long long ref_pair(unsigned int hi, unsigned int lo){
+
+	long long v = ((long long)(hi & 0xFF) << 32) | lo;
+
+	return v & 0x8000000000LL ? v - 0x10000000000LL : v;
+}
+
+void test_pairs(){
+
+	const char *name = "pairs";
+
+	for( long long i = 0; i < iterations; i++ ){
+		int reg = rng() & 31;
+		unsigned int lo = rng_word(), hi = rng_word();
+		long long v = (long long)rng();
+
+		//Reading what was written to the two registers
+		ctx->R[reg & ~1] = lo;
+		ctx->R[reg | 1] = hi;
+		if( pair_read(ctx, reg) != ref_pair(hi, lo) )
+			fail(name, "read of r%d:r%d = %#x:%#x gave %#llx", reg | 1, reg & ~1, hi, lo,
+					 pair_read(ctx, reg));
+		if( pair_read_u(ctx, reg) != ((unsigned long long)(hi & 0xFF) << 32 | lo) )
+			fail(name, "unsigned read of r%d:r%d = %#x:%#x gave %#llx", reg | 1, reg & ~1, hi, lo,
+					 pair_read_u(ctx, reg));
+
+		//Writing: the odd register keeps bits 39-32, cleared above, and the
+		//other registers do not change
+		ctx->R[reg ^ 2] = 0x5A5A5A5A;
+		pair_write(ctx, reg, v);
+		if( (unsigned int)ctx->R[reg & ~1] != (unsigned int)v ||
+				(unsigned int)ctx->R[reg | 1] != ((unsigned long long)v >> 32 & 0xFF) ||
+				ctx->R[reg ^ 2] != 0x5A5A5A5A )
+			fail(name, "write of %#llx to r%d:r%d gave %#x:%#x", v, reg | 1, reg & ~1,
+					 ctx->R[reg | 1], ctx->R[reg & ~1]);
+
+		//Round trip
+		if( pair_read(ctx, reg) != ref_pair((unsigned long long)v >> 32, (unsigned int)v) )
+			fail(name, "round trip of %#llx gave %#llx", v, pair_read(ctx, reg));
+	}
+}
+
+/*--------------------------------------------------------------------------------*/
+//Saturation
+
+/* Clamps v to [lo, hi], setting over when it does not fit */
+long long ref_clamp(long long v, long long lo, long long hi, int &over){
+
+	over = 0;
+	if( v > hi ){
+		over = 1;
+		return hi;
+	}
+	if( v < lo ){
+		over = 1;
+		return lo;
+	}
+	return v;
+}
+
+/* Random 64-bit value of random magnitude, so that every limit is crossed */
+long long rng_wide(){
+
+	long long v = (long long)rng();
+
+	return v >> (rng() % 64);
+}
+
+/* Checks the result and the sticky flag of one saturating operation */
+void check_sat(const char *name, long long arg, long long got, long long want, int over){
+
+	if( got != want || ctx->sat != over )
+		fail(name, "%#llx gave %#llx (sat %d), expected %#llx (sat %d)", arg, got, ctx->sat,
+				 want, over);
+	ctx->sat = 0;
+}
+
+void test_sat(){
+
+	static const long long edges[] = { INT_MAX, INT_MIN, MAX_LONG, -MAX_LONG - 1, 0 };
+	int over;
+
+	ctx->sat = 0;
+
+	//Random values and the values around each limit
+	for( long long i = 0; i < iterations; i++ ){
+		long long v = rng_wide();
+		long long want;
+
+		want = ref_clamp(v, INT_MIN, INT_MAX, over);
+		check_sat("sat32", v, sat32(v), want, over);
+		want = ref_clamp(v, -MAX_LONG - 1, MAX_LONG, over);
+		check_sat("sat40", v, sat40(v), want, over);
+	}
+	for( int e = 0; e < 5; e++ )
+		for( long long d = -2; d <= 2; d++ ){
+			long long v = edges[e] + d;
+			long long want;
+
+			want = ref_clamp(v, INT_MIN, INT_MAX, over);
+			check_sat("sat32", v, sat32(v), want, over);
+			want = ref_clamp(v, -MAX_LONG - 1, MAX_LONG, over);
+			check_sat("sat40", v, sat40(v), want, over);
+		}
+
+	//Every shift amount of random values
+	for( long long i = 0; i < iterations / 32; i++ ){
+		int v = (int)rng_word();
+
+		for( unsigned int sh = 0; sh < 32; sh++ ){
+			long long want = ref_clamp((long long)v * (1LL << sh), INT_MIN, INT_MAX, over);
+			check_sat("sat_shl32", ((long long)v << 8) | sh, sat_shl32(v, sh), want, over);
+		}
+	}
+
+	//Every pair of 16-bit operands
+	for( int a = -32768; a < 32768; a++ )
+		for( int b = -32768; b < 32768; b++ ){
+			int got = sat_mpy16(a, b);
+			long long want = ref_clamp(2LL * a * b, INT_MIN, INT_MAX, over);
+
+			if( got != want || ctx->sat != over )
+				check_sat("sat_mpy16", ((long long)a << 16) | (b & 0xFFFF), got, want, over);
+			ctx->sat = 0;
+		}
+}
+
+/*--------------------------------------------------------------------------------*/
+//Bit fields. The references are the bit loops the behaviors used before.
+
+int ref_lmbd(int bit, unsigned int data){
+
+	int i;
+
+	for( i = 31; i >= 0; i-- )
+		if( (int)(data >> i & 1) == (bit & 1) )
+			break;
+
+	return i < 0 ? 32 : 31 - i;
+}
+
+/* Redundant sign bits of the width-bit value v */
+int ref_norm(long long v, int width){
+
+	int sign = v >> (width - 1) & 1;
+	int i;
+
+	for( i = width - 2; i >= 0; i-- )
+		if( (v >> i & 1) != sign )
+			break;
+
+	return width - 2 - i;
+}
+
+/* CLR and SET: clears or sets the bits lsb to msb, none when msb < lsb */
+unsigned int ref_field(unsigned int v, unsigned int lsb, unsigned int msb, int set){
+
+	for( unsigned int i = lsb; i <= msb; i++ )
+		v = set ? v | 1u << i : v & ~(1u << i);
+
+	return v;
+}
+
+void test_bits(){
+
+	for( long long i = 0; i < iterations; i++ ){
+		unsigned int v = rng_word();
+		int bit = rng() & 3;
+		long long l = (long long)(((unsigned long long)rng_word() << 32 | rng_word()) << 24) >> 24;
+
+		if( lmbd(bit, v) != ref_lmbd(bit, v) )
+			fail("lmbd", "lmbd(%d, %#x) gave %d, expected %d", bit, v, lmbd(bit, v), ref_lmbd(bit, v));
+		if( norm32(v) != ref_norm((int)v, 32) )
+			fail("norm32", "%#x gave %d, expected %d", v, norm32(v), ref_norm((int)v, 32));
+		if( norm40(l) != ref_norm(l, 40) )
+			fail("norm40", "%#llx gave %d, expected %d", l, norm40(l), ref_norm(l, 40));
+	}
+
+	//Every field of random values
+	for( long long i = 0; i < iterations / 1024 + 1; i++ ){
+		unsigned int v = rng_word();
+
+		for( unsigned int lsb = 0; lsb < 32; lsb++ )
+			for( unsigned int msb = 0; msb < 32; msb++ ){
+				if( (v & ~field_mask(lsb, msb)) != ref_field(v, lsb, msb, 0) )
+					fail("field_mask", "clearing %u..%u of %#x gave %#x", lsb, msb, v,
+							 v & ~field_mask(lsb, msb));
+				if( (v | field_mask(lsb, msb)) != ref_field(v, lsb, msb, 1) )
+					fail("field_mask", "setting %u..%u of %#x gave %#x", lsb, msb, v,
+							 v | field_mask(lsb, msb));
+			}
+	}
+}
+
+/*--------------------------------------------------------------------------------*/
+//Predicates
+
+/* The switch the instruction behavior used before the table. Returns whether
+   the instruction runs, or -1 for a reserved creg. creg 0 (unconditional) is
+   handled by the caller, and -1 for both. */
+int ref_pred(const tms62x_ctx *c, unsigned int creg, unsigned int z){
+
+	int reg;
+
+	switch( creg ){
+	case 1:  //Test register B0
+		reg = c->R[16];
+		break;
+	case 2:  //Test register B1
+		reg = c->R[17];
+		break;
+	case 3:  //Test register B2
+		reg = c->R[18];
+		break;
+	case 4:  //Test register A1
+		reg = c->R[1];
+		break;
+	case 5:  //Test register A2
+		reg = c->R[2];
+		break;
+	default:
+		return -1;
+	}
+
+	if( z )
+		return reg == 0;
+	else
+		return reg != 0;
+}
+
+void test_pred(){
+
+	for( long long i = 0; i < iterations / 16 + 1; i++ ){
+		//Each tested register is zero half of the time
+		for( int r = 0; r < 32; r++ )
+			ctx->R[r] = rng() & 1 ? 0 : rng_word() | 1u << (rng() & 31);
+
+		for( unsigned int creg = 0; creg < 8; creg++ )
+			for( unsigned int z = 0; z < 2; z++ )
+				if( pred_pass(ctx, creg, z) != ref_pred(ctx, creg, z) )
+					fail("pred_pass", "creg %u z %u gave %d, expected %d", creg, z,
+							 pred_pass(ctx, creg, z), ref_pred(ctx, creg, z));
+
+		//The predicate resolved from a random word with the fetch packet
+		unsigned int word = (unsigned int)rng();
+		const pred_entry &pred = pred_decode(word);
+		int want = word >> 29 ? ref_pred(ctx, word >> 29, word >> 28 & 1) : -1;
+		int got = pred.reg < 0 ? -1 : !pred_annuls(ctx, pred.reg, pred.annul_nonzero);
+
+		if( got != want )
+			fail("pred_decode", "%#010x gave %d, expected %d", word, got, want);
+	}
+}
+
+/*--------------------------------------------------------------------------------*/
+//Decoder
+
+/* The first instruction, in declaration order, whose encoding matches word */
+int ref_decode(unsigned int word){
+
+	for( int i = 0; i < DEC_INSTRS; i++ )
+		if( (word & dec_instrs[i].mask) == dec_instrs[i].value )
+			return i;
+
+	return -1;
+}
+
+//Offset of every operand field in dec_operands
+struct field_offset {
+	const char *name;
+	size_t offset;
+};
+
+#define FIELD_OFFSET(f) { #f, offsetof(dec_operands, f) },
+static const field_offset field_offsets[] = { DEC_FIELD_LIST(FIELD_OFFSET) { 0, 0 } };
+#undef FIELD_OFFSET
+
+/* Checks the decoding of word and the operands given by its extractor */
+void check_decode(unsigned int word){
+
+	int id = tms62x_decode(word);
+	dec_operands o;
+
+	if( id != ref_decode(word) ){
+		fail("decode", "%#010x gave %d, expected %d", word, id, ref_decode(word));
+		return;
+	}
+	if( id < 0 )
+		return;
+
+	memset(&o, 0x55, sizeof(o));
+	dec_extractors[dec_instrs[id].format](o, word);
+
+	for( const dec_field *fl = dec_format_fields[dec_instrs[id].format]; fl->name; fl++ ){
+		const field_offset *f = field_offsets;
+		int v;
+
+		while( strcmp(f->name, fl->name) )
+			f++;
+		memcpy(&v, (char *)&o + f->offset, sizeof(v));
+		if( v != dec_extract(word, *fl) )
+			fail("extract", "field %s of %#010x (%s) gave %d, expected %d", fl->name, word,
+					 dec_instrs[id].name, v, dec_extract(word, *fl));
+	}
+}
+
+void test_decode(){
+
+	//Random words, most of them invalid
+	for( long long i = 0; i < iterations; i++ )
+		check_decode((unsigned int)rng());
+
+	//Every instruction with random operand bits
+	for( long long i = 0; i < iterations / 256 + 1; i++ )
+		for( int id = 0; id < DEC_INSTRS; id++ )
+			check_decode(dec_instrs[id].value | ((unsigned int)rng() & ~dec_instrs[id].mask));
+}
+
+/*--------------------------------------------------------------------------------*/
+//Instructions, decoded and executed by the library. Each check writes one
+//instruction at address 0 and runs it alone, up to the next word.
+
+#define END ((char *)0)
+
+//Addressing mode and control status registers, and the saturation bit
+#define REG_AMR 0
+#define REG_CSR 1
+#define CSR_SAT (1u << 9)
+
+//Registers of the checked instructions: src1, src2 (or the src2 pair) and
+//dst (or the dst pair)
+#define REG_SRC1 3
+#define REG_SRC2 4
+#define REG_DST  6
+
+tms62x_sim *sim;
+
+/* Runs the instruction word alone. Returns 0 if it did not run. */
+int run_insn(const char *test, unsigned int word){
+
+	unsigned char image[4];
+
+	asm_image(image, &word, 1);
+	tms62x_write_mem(sim, 0, image, sizeof(image));
+	tms62x_set_pc(sim, 0);
+	if( tms62x_run(sim, -1, 4) != TMS62X_PC ){
+		fail(test, "%#010x did not run", word);
+		return 0;
+	}
+
+	return 1;
+}
+
+/* Writes the 40 low bits of v to the pair at reg of side s. The bits of the
+   odd register above bit 39 get garbage, which the instructions ignore. */
+void set_pair(int s, int reg, unsigned long long v){
+
+	tms62x_set_reg(sim, s, reg, (unsigned int)v);
+	tms62x_set_reg(sim, s, reg + 1, (rng_word() & ~0xFFu) | (unsigned int)(v >> 32 & 0xFF));
+}
+
+//Operand kinds: registers of 32 or 40 bits, signed or not, the low or high
+//half of a register, signed or not, and constants
+enum { OPD_NONE, OPD_INT, OPD_UINT, OPD_LONG, OPD_ULONG, OPD_LO, OPD_LOU, OPD_HI, OPD_HIU,
+       OPD_SCST5, OPD_UCST4, OPD_UCST5 };
+
+/* Random operand of a kind. Returns its value, and sets its field and the
+   register or pair that holds it. */
+long long rng_operand(int kind, int s, int reg, unsigned int &field){
+
+	unsigned int lo = rng_word(), hi = rng_word();
+	long long v;
+
+	//The upper bits of a 40-bit value are edge cases half of the time
+	if( rng() & 1 ){
+		static const unsigned int edges[] = { 0x00, 0x7F, 0x80, 0xFF };
+
+		hi = edges[rng() & 3];
+	}
+
+	field = reg;
+	switch( kind ){
+	case OPD_INT:
+	case OPD_UINT:
+		tms62x_set_reg(sim, s, reg, lo);
+		return kind == OPD_INT ? (long long)(int)lo : (long long)lo;
+	case OPD_LONG:
+	case OPD_ULONG:
+		set_pair(s, reg, (unsigned long long)(hi & 0xFF) << 32 | lo);
+		v = ref_pair(hi, lo);
+		return kind == OPD_LONG ? v : v & 0xFFFFFFFFFFLL;
+	case OPD_LO:
+	case OPD_LOU:
+	case OPD_HI:
+	case OPD_HIU:
+		tms62x_set_reg(sim, s, reg, lo);
+		lo = kind == OPD_HI || kind == OPD_HIU ? lo >> 16 : lo & 0xFFFF;
+		return kind == OPD_LO || kind == OPD_HI ? (long long)(short)lo : (long long)lo;
+	case OPD_SCST5:
+		field = rng() & 31;
+		return (long long)field - (field & 16) * 2;
+	case OPD_UCST4:
+		field = rng() & 15;
+		return field;
+	case OPD_UCST5:
+		field = rng() & 31;
+		return field;
+	default:
+		field = 0;
+		return 0;
+	}
+}
+
+enum { REF_ADD, REF_SUB, REF_SADD, REF_SSUB, REF_CMPEQ, REF_CMPGT, REF_CMPLT, REF_ABS, REF_SAT,
+       REF_NORM, REF_MPY, REF_SHL, REF_SHR, REF_SHRU };
+
+/* 64-bit reference of the operation on the source values a and b, b being
+   the shifted value and a the shift amount. Sets over when the result
+   saturated. */
+long long ref_op(int op, long long a, long long b, int &over){
+
+	//Shift amounts are the 6 LSB of src1, and above 39 shift by 40
+	int amount = (a & 0x3F) > 39 ? 40 : (int)(a & 0x3F);
+
+	over = 0;
+	switch( op ){
+	case REF_ADD:
+		return a + b;
+	case REF_SUB:
+		return a - b;
+	case REF_SADD:
+		return ref_clamp(a + b, -MAX_LONG - 1, MAX_LONG, over);
+	case REF_SSUB:
+		return ref_clamp(a - b, -MAX_LONG - 1, MAX_LONG, over);
+	case REF_CMPEQ:
+		return a == b;
+	case REF_CMPGT:
+		return a > b;
+	case REF_CMPLT:
+		return a < b;
+	case REF_ABS:
+		//The most negative value gives the largest positive one, without SAT
+		return b == -MAX_LONG - 1 ? MAX_LONG : b < 0 ? -b : b;
+	case REF_SAT:
+		return ref_clamp(b, INT_MIN, INT_MAX, over);
+	case REF_NORM:
+		return ref_norm(b, 40);
+	case REF_MPY:
+		return a * b;
+	case REF_SHL:
+		return (long long)((unsigned long long)b << amount);
+	case REF_SHR:
+		return b >> amount;
+	default:
+		return (long long)((unsigned long long)b >> amount);
+	}
+}
+
+//An instruction, with the kinds of its operands
+struct insn_check {
+	const char *name;
+	int op;
+	int src1, src2, dst;
+};
+
+//The instructions on 40-bit values
+static const insn_check long_checks[] = {
+	{ "add_l_iil",  REF_ADD,   OPD_INT,   OPD_INT,   OPD_LONG },
+	{ "add_l_ill",  REF_ADD,   OPD_INT,   OPD_LONG,  OPD_LONG },
+	{ "add_l_cll",  REF_ADD,   OPD_SCST5, OPD_LONG,  OPD_LONG },
+	{ "addu_iil",   REF_ADD,   OPD_UINT,  OPD_UINT,  OPD_LONG },
+	{ "addu_ill",   REF_ADD,   OPD_UINT,  OPD_ULONG, OPD_LONG },
+	{ "sub_l_iil",  REF_SUB,   OPD_INT,   OPD_INT,   OPD_LONG },
+	{ "sub_l_xiil", REF_SUB,   OPD_INT,   OPD_INT,   OPD_LONG },
+	{ "sub_l_cll",  REF_SUB,   OPD_SCST5, OPD_LONG,  OPD_LONG },
+	{ "subu_iil",   REF_SUB,   OPD_UINT,  OPD_UINT,  OPD_LONG },
+	{ "subu_xiil",  REF_SUB,   OPD_UINT,  OPD_UINT,  OPD_LONG },
+	{ "abs_ll",     REF_ABS,   OPD_NONE,  OPD_LONG,  OPD_LONG },
+	{ "sadd_ill",   REF_SADD,  OPD_INT,   OPD_LONG,  OPD_LONG },
+	{ "sadd_cll",   REF_SADD,  OPD_SCST5, OPD_LONG,  OPD_LONG },
+	{ "ssub_cll",   REF_SSUB,  OPD_SCST5, OPD_LONG,  OPD_LONG },
+	{ "cmpeq_ili",  REF_CMPEQ, OPD_INT,   OPD_LONG,  OPD_INT },
+	{ "cmpeq_cli",  REF_CMPEQ, OPD_SCST5, OPD_LONG,  OPD_INT },
+	{ "cmpgt_ili",  REF_CMPGT, OPD_INT,   OPD_LONG,  OPD_INT },
+	{ "cmpgt_cli",  REF_CMPGT, OPD_SCST5, OPD_LONG,  OPD_INT },
+	{ "cmpgtu_ili", REF_CMPGT, OPD_UINT,  OPD_ULONG, OPD_INT },
+	{ "cmpgtu_cli", REF_CMPGT, OPD_UCST4, OPD_ULONG, OPD_INT },
+	{ "cmplt_ili",  REF_CMPLT, OPD_INT,   OPD_LONG,  OPD_INT },
+	{ "cmplt_cli",  REF_CMPLT, OPD_SCST5, OPD_LONG,  OPD_INT },
+	{ "cmpltu_ili", REF_CMPLT, OPD_UINT,  OPD_ULONG, OPD_INT },
+	{ "cmpltu_cli", REF_CMPLT, OPD_UCST4, OPD_ULONG, OPD_INT },
+	{ "norm_li",    REF_NORM,  OPD_NONE,  OPD_LONG,  OPD_INT },
+	{ "sat",        REF_SAT,   OPD_NONE,  OPD_LONG,  OPD_INT },
+	{ "shl_lil",    REF_SHL,   OPD_UINT,  OPD_LONG,  OPD_LONG },
+	{ "shl_iil",    REF_SHL,   OPD_UINT,  OPD_INT,   OPD_LONG },
+	{ "shl_lcl",    REF_SHL,   OPD_UCST5, OPD_LONG,  OPD_LONG },
+	{ "shl_icl",    REF_SHL,   OPD_UCST5, OPD_INT,   OPD_LONG },
+	{ "shr_lil",    REF_SHR,   OPD_UINT,  OPD_LONG,  OPD_LONG },
+	{ "shr_lcl",    REF_SHR,   OPD_UCST5, OPD_LONG,  OPD_LONG },
+	{ "shru_lil",   REF_SHRU,  OPD_UINT,  OPD_ULONG, OPD_LONG },
+	{ "shru_lcl",   REF_SHRU,  OPD_UCST5, OPD_ULONG, OPD_LONG },
+};
+
+//Multiplies, whose operands are the halves of the sources in every signedness,
+//and 32-bit shifts, whose register amounts are often 32 or more
+static const insn_check int_checks[] = {
+	{ "mpy",        REF_MPY,   OPD_LO,    OPD_LO,    OPD_INT },
+	{ "mpyu",       REF_MPY,   OPD_LOU,   OPD_LOU,   OPD_INT },
+	{ "mpyus",      REF_MPY,   OPD_LOU,   OPD_LO,    OPD_INT },
+	{ "mpysu",      REF_MPY,   OPD_LO,    OPD_LOU,   OPD_INT },
+	{ "mpyh",       REF_MPY,   OPD_HI,    OPD_HI,    OPD_INT },
+	{ "mpyhu",      REF_MPY,   OPD_HIU,   OPD_HIU,   OPD_INT },
+	{ "mpyhus",     REF_MPY,   OPD_HIU,   OPD_HI,    OPD_INT },
+	{ "mpyhsu",     REF_MPY,   OPD_HI,    OPD_HIU,   OPD_INT },
+	{ "mpyhl",      REF_MPY,   OPD_HI,    OPD_LO,    OPD_INT },
+	{ "mpyhlu",     REF_MPY,   OPD_HIU,   OPD_LOU,   OPD_INT },
+	{ "mpyhuls",    REF_MPY,   OPD_HIU,   OPD_LO,    OPD_INT },
+	{ "mpyhslu",    REF_MPY,   OPD_HI,    OPD_LOU,   OPD_INT },
+	{ "mpylh",      REF_MPY,   OPD_LO,    OPD_HI,    OPD_INT },
+	{ "mpylhu",     REF_MPY,   OPD_LOU,   OPD_HIU,   OPD_INT },
+	{ "mpyluhs",    REF_MPY,   OPD_LOU,   OPD_HI,    OPD_INT },
+	{ "mpylshu",    REF_MPY,   OPD_LO,    OPD_HIU,   OPD_INT },
+	{ "shl_iii",    REF_SHL,   OPD_UINT,  OPD_INT,   OPD_INT },
+	{ "shl_ici",    REF_SHL,   OPD_UCST5, OPD_INT,   OPD_INT },
+	{ "shr_iii",    REF_SHR,   OPD_UINT,  OPD_INT,   OPD_INT },
+	{ "shr_ici",    REF_SHR,   OPD_UCST5, OPD_INT,   OPD_INT },
+	{ "shru_iii",   REF_SHRU,  OPD_UINT,  OPD_UINT,  OPD_INT },
+	{ "shru_ici",   REF_SHRU,  OPD_UCST5, OPD_UINT,  OPD_INT },
+};
+
+/* Runs every instruction of checks on random operands */
+void check_insns(const insn_check *checks, int count){
+
+	for( int i = 0; i < count; i++ ){
+		const insn_check &c = checks[i];
+
+		for( long long n = 0; n < iterations / 256 + 1; n++ ){
+			int s = rng() & 1, over, sat;
+			unsigned int f1, f2, word;
+			long long a, b, want, got;
+
+			a = rng_operand(c.src1, s, REG_SRC1, f1);
+			b = rng_operand(c.src2, s, REG_SRC2, f2);
+			tms62x_set_reg(sim, TMS62X_RB_C, REG_CSR, 0);
+
+			word = asm_insn(c.name, "s", s, "src1", f1, "src2", f2, "dst", REG_DST, END);
+			if( !run_insn(c.name, word) )
+				continue;
+
+			want = ref_op(c.op, a, b, over);
+			sat = (tms62x_get_reg(sim, TMS62X_RB_C, REG_CSR) & CSR_SAT) != 0;
+			if( c.dst == OPD_LONG ){
+				unsigned int hi = tms62x_get_reg(sim, s, REG_DST + 1);
+
+				got = (long long)(hi & 0xFF) << 32 | tms62x_get_reg(sim, s, REG_DST);
+				want &= 0xFFFFFFFFFFLL;
+				if( hi >> 8 )
+					fail(c.name, "odd register of the result %#x not cleared above bit 39", hi);
+			}
+			else {
+				got = tms62x_get_reg(sim, s, REG_DST);
+				want &= 0xFFFFFFFF;
+			}
+
+			if( got != want || sat != over )
+				fail(c.name, "src1 %#llx src2 %#llx gave %#llx (sat %d), expected %#llx (sat %d)",
+						 a, b, got, sat, want, over);
+		}
+	}
+}
+
+void test_long(){
+
+	check_insns(long_checks, sizeof(long_checks) / sizeof(long_checks[0]));
+}
+
+void test_int(){
+
+	check_insns(int_checks, sizeof(int_checks) / sizeof(int_checks[0]));
+}
+
+//Address arithmetic, with the access size of each instruction
+struct adda_check {
+	const char *name;
+	int add;
+	int scale;
+	int cst;
+};
+
+static const adda_check adda_checks[] = {
+	{ "addab_iii", 1, 0, 0 }, { "addah_iii", 1, 1, 0 }, { "addaw_iii", 1, 2, 0 },
+	{ "addab_ici", 1, 0, 1 }, { "addah_ici", 1, 1, 1 }, { "addaw_ici", 1, 2, 1 },
+	{ "subab_iii", 0, 0, 0 }, { "subah_iii", 0, 1, 0 }, { "subaw_iii", 0, 2, 0 },
+	{ "subab_ici", 0, 0, 1 }, { "subah_ici", 0, 1, 1 }, { "subaw_ici", 0, 2, 1 },
+};
+
+/* The address arithmetic instructions, with src2 (A4-A7 or B4-B7) in linear
+   or circular mode. In circular mode only the address bits inside the block
+   of 2^(N+1) bytes change, N taken from BK0 or BK1. */
+void test_adda(){
+
+	for( unsigned int i = 0; i < sizeof(adda_checks) / sizeof(adda_checks[0]); i++ ){
+		const adda_check &c = adda_checks[i];
+
+		for( long long n = 0; n < iterations / 256 + 1; n++ ){
+			int s = rng() & 1, reg = 4 | (rng() & 3);
+			unsigned int mode = rng() % 3, bk0 = rng() & 31, bk1 = rng() & 31;
+			unsigned int base = rng_word(), operand, amr, want, moved, mask;
+
+			//The mode field of src2 and both block sizes
+			amr = mode << (2 * ((s << 2) | (reg & 3))) | bk0 << 16 | bk1 << 21;
+			tms62x_set_reg(sim, TMS62X_RB_C, REG_AMR, amr);
+			tms62x_set_reg(sim, s, reg, base);
+			if( c.cst )
+				operand = rng() & 31;
+			else
+				tms62x_set_reg(sim, s, REG_SRC1, operand = rng_word());
+
+			if( !run_insn(c.name, asm_insn(c.name, "s", s, "src1", c.cst ? operand : REG_SRC1,
+																		 "src2", reg, "dst", REG_DST, END)) )
+				continue;
+
+			moved = c.add ? base + (operand << c.scale) : base - (operand << c.scale);
+			mask = mode ? (2u << (mode == 1 ? bk0 : bk1)) - 1 : 0xFFFFFFFF;
+			want = (base & ~mask) | (moved & mask);
+			if( tms62x_get_reg(sim, s, REG_DST) != want )
+				fail(c.name, "%s%d = %#x, src1 %#x, AMR %#x gave %#x, expected %#x", s ? "B" : "A",
+						 reg, base, operand, amr, tms62x_get_reg(sim, s, REG_DST), want);
+		}
+	}
+
+	tms62x_set_reg(sim, TMS62X_RB_C, REG_AMR, 0);
+}
+
+//Loads, with their access size and whether they sign extend
+struct load_check {
+	const char *name;
+	int scale;
+	int sign;
+};
+
+static const load_check load_checks[] = {
+	{ "ldb", 0, 1 }, { "ldbu", 0, 0 }, { "ldh", 1, 1 }, { "ldhu", 1, 0 }, { "ldw", 2, 0 }
+};
+
+//Destination of the loads, apart from their base registers
+#define LOAD_DST   8
+
+//Memory read by the loads, holding LOAD_BYTE(addr) at every address
+#define LOAD_BASE  0x1000
+#define LOAD_SIZE  0x2000
+#define LOAD_BYTE(a) (((a) * 7 + 3) & 0xFF)
+
+/* The loads with a base register (A4-A7 or B4-B7) in every addressing mode,
+   linear and circular: the address they read and the base register update */
+void test_ldst(){
+
+	static const int modes[] = { 0x0, 0x1, 0x4, 0x5, 0x8, 0x9, 0xA, 0xB, 0xC, 0xD, 0xE, 0xF };
+	unsigned char data[LOAD_SIZE];
+
+	for( int a = 0; a < LOAD_SIZE; a++ )
+		data[a] = LOAD_BYTE(LOAD_BASE + a);
+	tms62x_write_mem(sim, LOAD_BASE, data, LOAD_SIZE);
+
+	for( unsigned int i = 0; i < sizeof(load_checks) / sizeof(load_checks[0]); i++ ){
+		const load_check &c = load_checks[i];
+
+		for( long long n = 0; n < iterations / 256 + 1; n++ ){
+			int y = rng() & 1, reg = 4 | (rng() & 3), mode = modes[rng() % 12];
+			unsigned int circ = rng() % 3, bk = rng() & 7, offset = rng() & 31;
+			unsigned int base, amr, moved, mask, addr, want, got, size = 1u << c.scale;
+
+			//Bases in the middle of the memory read, aligned to the access size
+			base = (LOAD_BASE + LOAD_SIZE / 4 + (rng() % (LOAD_SIZE / 2))) & ~(size - 1);
+			amr = circ << (2 * ((y << 2) | (reg & 3))) | bk << 16 | bk << 21;
+			tms62x_set_reg(sim, TMS62X_RB_C, REG_AMR, amr);
+			tms62x_set_reg(sim, y, reg, base);
+			if( mode & 4 )
+				tms62x_set_reg(sim, y, REG_SRC1, offset);
+
+			if( !run_insn(c.name, asm_insn(c.name, "s", y, "y", y, "mode", mode, "baseR", reg,
+																		 "offsetR", mode & 4 ? REG_SRC1 : offset, "dst", LOAD_DST, END)) )
+				continue;
+
+			moved = mode & 1 ? base + (offset << c.scale) : base - (offset << c.scale);
+			mask = circ ? (2u << bk) - 1 : 0xFFFFFFFF;
+			moved = (base & ~mask) | (moved & mask);
+			addr = (mode & 8) && (mode & 2) ? base : moved;
+
+			want = 0;
+			for( unsigned int b = 0; b < size; b++ )
+				want = want << 8 | LOAD_BYTE(addr + b);
+			if( c.sign && want >> (8 * size - 1) & 1 )
+				want |= ~0u << (8 * size - 1);
+
+			got = tms62x_get_reg(sim, y, LOAD_DST);
+			if( got != want )
+				fail(c.name, "mode %#x %s%d = %#x, offset %u, AMR %#x read %#x, expected %#x from %#x",
+						 mode, y ? "B" : "A", reg, base, offset, amr, got, want, addr);
+			if( tms62x_get_reg(sim, y, reg) != (mode & 8 ? moved : base) )
+				fail(c.name, "mode %#x %s%d = %#x, offset %u, AMR %#x left the base at %#x, expected %#x",
+						 mode, y ? "B" : "A", reg, base, offset, amr, tms62x_get_reg(sim, y, reg),
+						 mode & 8 ? moved : base);
+		}
+	}
+
+	tms62x_set_reg(sim, TMS62X_RB_C, REG_AMR, 0);
+}
+
+/* Runs the program of s from pc 0 up to its idle, which is left unrun so the
+   program can run again, and returns A4 */
+unsigned int run_prog(tms62x_sim *s){
+
+	tms62x_set_reg(s, TMS62X_RB_A, 4, 0);
+	tms62x_set_pc(s, 0);
+	if( tms62x_run(s, -1, 4) != TMS62X_PC )
+		return ~0u;
+	return tms62x_get_reg(s, TMS62X_RB_A, 4);
+}
+
+/* Instances that load the same program share its decoding: a program written
+   over in one of them, loaded with other bytes or copied must not change what
+   the others run */
+void test_prog(){
+
+	unsigned int words[2], changed;
+	unsigned char image[sizeof(words)], patch[4];
+	tms62x_sim *other;
+
+	words[0] = asm_insn("mvk", "dst", 4, "cst", 7, END);
+	words[1] = asm_insn("idle", END);
+	asm_image(image, words, 2);
+	changed = asm_insn("mvk", "dst", 4, "cst", 9, END);
+	asm_image(patch, &changed, 1);
+
+	if( !(other = tms62x_create()) ){
+		fail("prog", "could not create a second simulator");
+		return;
+	}
+	if( tms62x_load(sim, image, sizeof(image), 0) || tms62x_load(other, image, sizeof(image), 0) ){
+		fail("prog", "could not load the program");
+		tms62x_destroy(other);
+		return;
+	}
+
+	if( run_prog(sim) != 7 || run_prog(other) != 7 )
+		fail("prog", "the shared program did not set A4 to 7");
+
+	tms62x_write_mem(other, 0, patch, sizeof(patch));
+	if( run_prog(other) != 9 )
+		fail("prog", "the program written over was not run");
+	if( run_prog(sim) != 7 )
+		fail("prog", "writing over the program of one instance changed another");
+
+	tms62x_copy_state(other, sim);
+	if( run_prog(other) != 7 )
+		fail("prog", "the copied instance did not run the program copied");
+	tms62x_reset(sim);
+	if( run_prog(sim) != 7 )
+		fail("prog", "the program was not restored by the reset");
+
+	asm_image(image, &changed, 1);
+	tms62x_load(other, image, sizeof(image), 0);
+	if( run_prog(other) != 9 || run_prog(sim) != 7 )
+		fail("prog", "a program loaded with other bytes was not decoded apart");
+
+	tms62x_destroy(other);
+}
+
+/*--------------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[]){
+
+	if( argc > 1 )
+		iterations = atoll(argv[1]);
+
+	ctx = &test_ctx;
+	test_pairs();
+	test_sat();
+	test_bits();
+	test_pred();
+	test_decode();
+
+	if( !(sim = tms62x_create()) ){
+		fprintf(stderr, "Could not create the simulator\n");
+		return 1;
+	}
+	test_long();
+	test_int();
+	test_adda();
+	test_ldst();
+	test_prog();
+	tms62x_destroy(sim);
+
+	if( failures ){
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+
+	fprintf(stderr, "All checks passed (%lld iterations)\n", iterations);
+	return 0;
+}